@@ -2,11 +2,17 @@
 #include "configuration.h"
 #include "create_actor.h"
 #include "create_network.h"
+#include "profiler.h"
 #include "random.h"
 #include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <torch/cuda.h>
 #include <utility>
 
@@ -15,26 +21,103 @@ namespace minizero::actor {
 using namespace network;
 using namespace utils;
 
-int ThreadSharedData::getAvailableActorIndex()
+void ActorRequestQueue::push(InferenceRequest* request)
 {
-    std::lock_guard lock(mutex_);
-    return (actor_index_ < static_cast<int>(actors_.size()) ? actor_index_++ : actors_.size());
+    queue_.push(request);
+    ++num_ready_requests_;
+    notify();
+}
+
+void ActorRequestQueue::submit(InferenceRequest* request, InferenceService& service)
+{
+    ++num_inflight_requests_;
+    service.submit(request);
+}
+
+void ActorRequestQueue::complete(InferenceRequest* request)
+{
+    queue_.push(request);
+    ++num_ready_requests_;
+    --num_inflight_requests_;
+    notify();
+}
+
+InferenceRequest* ActorRequestQueue::pop(const std::atomic<bool>& is_paused)
+{
+    // return nullptr once the actor group pauses, the requests completed meanwhile are kept for the next run
+    while (!is_paused) {
+        if (num_ready_requests_ > 0) {
+            InferenceRequest* request = queue_.pop();
+            if (request) {
+                --num_ready_requests_;
+                return request;
+            }
+            continue; // the request is being pushed
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        is_waiting_ = true;
+        cv_.wait(lock, [this, &is_paused] { return num_ready_requests_ > 0 || is_paused; });
+        is_waiting_ = false;
+    }
+    return nullptr;
+}
+
+void ActorRequestQueue::waitForInflightRequests()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    is_waiting_ = true;
+    cv_.wait(lock, [this] { return num_inflight_requests_ == 0; });
+    is_waiting_ = false;
+}
+
+void ActorRequestQueue::wake()
+{
+    // called after the actor group pauses, a thread checking the pause under the lock cannot miss it
+    std::lock_guard<std::mutex> lock(mutex_);
+    cv_.notify_one();
+}
+
+void ActorRequestQueue::notify()
+{
+    // only wake the slave thread when it sleeps, the check after the update cannot miss a thread that is going to sleep
+    if (is_waiting_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_one();
+    }
+}
+
+int ThreadSharedData::getAvailableActorIndex(int thread_id)
+{
+    // the actors of the CPU cohort are cpu_cohort_, cpu_cohort_ + num_cohorts_, cpu_cohort_ + 2 * num_cohorts_, ...
+    int index = actor_ranges_.getNextIndex(thread_id);
+    return (index == -1 ? actors_.size() : cpu_cohort_ + index * num_cohorts_);
+}
+
+int ThreadSharedData::getActorThreadIndex(int actor_id) const
+{
+    // the thread whose initial range of actor_ranges_ contains the actor, i.e., the thread running the actor unless another thread steals it
+    int num_cohort_actors = (actors_.size() - actor_id % num_cohorts_ + num_cohorts_ - 1) / num_cohorts_;
+    return (static_cast<int64_t>(actor_id / num_cohorts_) * num_threads_ + num_threads_ - 1) / num_cohort_actors;
 }
 
 void ThreadSharedData::outputGame(const std::shared_ptr<BaseActor>& actor)
 {
+    ProfileTimer timer(ProfilePhase::kGameOutput);
     int game_length = actor->getEnvironment().getActionHistory().size();
     std::pair<int, int> data_range = calculateTrainingDataRange(actor);
 
-    std::ostringstream oss;
+    // build the record here since the actor keeps playing, and leave the compression and the output to the writer thread
     bool is_terminal = (config::zero_actor_intermediate_sequence_length == 0 || actor->isEnvTerminal());
+    std::unique_ptr<GameRecord> record = std::make_unique<GameRecord>();
+    std::ostringstream oss;
     oss << "SelfPlay "
-        << (is_terminal ? "true" : "false") << " "                                                                         // is terminal
-        << (data_range.second - data_range.first + 1) << " "                                                               // data length
-        << game_length << " "                                                                                              // game length
-        << actor->getEnvironment().getEvalScore(!actor->isEnvTerminal()) << " "                                            // return
-        << actor->getRecord({{"DLEN", std::to_string(data_range.first) + "-" + std::to_string(data_range.second)}}) << " " // game record
-        << "#";                                                                                                            // end mark for a valid game
+        << (is_terminal ? "true" : "false") << " "                        // is terminal
+        << (data_range.second - data_range.first + 1) << " "              // data length
+        << game_length << " "                                             // game length
+        << actor->getEnvironment().getEvalScore(!actor->isEnvTerminal()); // return
+    record->header_ = oss.str();
+    record->env_loader_ = actor->getRecordLoader({{"DLEN", std::to_string(data_range.first) + "-" + std::to_string(data_range.second)}}, true);
 
     if (!is_terminal) {
         // delete action info history if not complete record to save memory
@@ -45,8 +128,7 @@ void ThreadSharedData::outputGame(const std::shared_ptr<BaseActor>& actor)
         }
     }
 
-    std::lock_guard lock(mutex_);
-    std::cout << oss.str() << std::endl;
+    record_writer_->write(std::move(record));
 }
 
 std::pair<int, int> ThreadSharedData::calculateTrainingDataRange(const std::shared_ptr<BaseActor>& actor)
@@ -68,46 +150,89 @@ void SlaveThread::initialize()
 
 void SlaveThread::runJob()
 {
-    if (getSharedData()->do_cpu_job_) {
+    if (getSharedData()->is_async_) {
+        runActorsAsync();
+        return;
+    }
+
+    // the threads owning a network of the GPU cohort evaluate its batch first, then all threads run the actors of the CPU cohort
+    auto start_time = std::chrono::steady_clock::now();
+    if (getSharedData()->gpu_cohort_ != -1 && doGPUJob()) {
+        auto end_time = std::chrono::steady_clock::now();
+        getSharedData()->gpu_busy_time_ += std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
+        start_time = end_time;
+    }
+    if (getSharedData()->cpu_cohort_ != -1) {
         while (doCPUJob()) {}
-    } else {
-        doGPUJob();
+        getSharedData()->cpu_busy_time_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
     }
 }
 
 bool SlaveThread::doCPUJob()
 {
-    size_t actor_id = getSharedData()->getAvailableActorIndex();
+    size_t actor_id = getSharedData()->getAvailableActorIndex(id_);
     if (actor_id >= getSharedData()->actors_.size()) { return false; }
 
     std::shared_ptr<BaseActor>& actor = getSharedData()->actors_[actor_id];
-    int network_id = actor_id % getSharedData()->networks_.size();
-    int network_output_id = actor->getNNEvaluationBatchIndex();
-    if (network_output_id >= 0) {
-        assert(network_output_id < static_cast<int>(getSharedData()->network_outputs_[network_id].size()));
-        actor->afterNNEvaluation(getSharedData()->network_outputs_[network_id][network_output_id]);
+    int network_id = getSharedData()->getNetworkIndex(actor_id);
+    if (actor->getNNEvaluationBatchIndex() >= 0) {
+        actor->afterNNEvaluationBatch(getSharedData()->network_outputs_[network_id]);
         if (actor->isSearchDone()) { handleSearchDone(actor_id); }
     }
-    actor->beforeNNEvaluation();
+    actor->beforeNNEvaluationBatch(config::actor_mcts_self_play_batch_size);
     return true;
 }
 
-void SlaveThread::doGPUJob()
+bool SlaveThread::doGPUJob()
 {
-    if (id_ >= static_cast<int>(getSharedData()->networks_.size())) { return; }
+    // return true if a batch is evaluated
+    int num_networks = getSharedData()->getNumNetworksPerCohort();
+    if (id_ >= num_networks) { return false; }
 
-    std::shared_ptr<Network>& network = getSharedData()->networks_[id_];
+    int network_id = getSharedData()->gpu_cohort_ * num_networks + id_;
+    std::shared_ptr<Network>& network = getSharedData()->networks_[network_id];
     if (network->getNetworkTypeName() == "alphazero") {
         std::shared_ptr<AlphaZeroNetwork> az_network = std::static_pointer_cast<AlphaZeroNetwork>(network);
-        if (az_network->getBatchSize() > 0) { getSharedData()->network_outputs_[id_] = az_network->forward(); }
+        if (az_network->getBatchSize() > 0) {
+            getSharedData()->network_outputs_[network_id] = az_network->forward();
+            return true;
+        }
     } else if (network->getNetworkTypeName() == "muzero" || network->getNetworkTypeName() == "muzero_atari") {
         std::shared_ptr<MuZeroNetwork> muzero_network = std::static_pointer_cast<MuZeroNetwork>(network);
         if (muzero_network->getInitialInputBatchSize() > 0) {
-            getSharedData()->network_outputs_[id_] = std::static_pointer_cast<MuZeroNetwork>(network)->initialInference();
+            getSharedData()->network_outputs_[network_id] = std::static_pointer_cast<MuZeroNetwork>(network)->initialInference();
+            return true;
         } else if (muzero_network->getRecurrentInputBatchSize() > 0) {
-            getSharedData()->network_outputs_[id_] = std::static_pointer_cast<MuZeroNetwork>(network)->recurrentInference();
+            getSharedData()->network_outputs_[network_id] = std::static_pointer_cast<MuZeroNetwork>(network)->recurrentInference();
+            return true;
+        }
+    }
+    return false;
+}
+
+void SlaveThread::runActorsAsync()
+{
+    // run the actors of this thread whenever their requests are completed, until the actor group pauses
+    std::shared_ptr<ThreadSharedData> shared_data = getSharedData();
+    ActorRequestQueue& actor_requests = *shared_data->actor_requests_[id_];
+    int64_t busy_time = 0;
+    while (InferenceRequest* request = actor_requests.pop(shared_data->is_paused_)) {
+        auto start_time = std::chrono::steady_clock::now();
+        int actor_id = request->id_;
+        std::shared_ptr<BaseActor>& actor = shared_data->actors_[actor_id];
+        if (actor->getNNEvaluationBatchIndex() >= 0) {
+            actor->afterNNEvaluation(request->output_);
+            if (actor->isSearchDone()) { handleSearchDone(actor_id); }
         }
+        actor->beforeNNEvaluation();
+        request->model_ = actor->getNNEvaluationModel();
+        actor_requests.submit(request, *shared_data->inference_services_[shared_data->getNetworkIndex(actor_id)]);
+        busy_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
     }
+    shared_data->cpu_busy_time_ += busy_time;
+
+    // wait for the submitted requests, so that the networks are idle when the commands are handled
+    actor_requests.waitForInflightRequests();
 }
 
 void SlaveThread::handleSearchDone(int actor_id)
@@ -115,11 +240,17 @@ void SlaveThread::handleSearchDone(int actor_id)
     assert(actor_id >= 0 && actor_id < static_cast<int>(getSharedData()->actors_.size()) && getSharedData()->actors_[actor_id]->isSearchDone());
 
     std::shared_ptr<BaseActor>& actor = getSharedData()->actors_[actor_id];
+    if (Profiler::isEnabled()) {
+        auto now = std::chrono::steady_clock::now();
+        Profiler::addMoveLatency(std::chrono::duration_cast<std::chrono::microseconds>(now - getSharedData()->move_start_times_[actor_id]).count());
+        getSharedData()->move_start_times_[actor_id] = now;
+    }
     if (!actor->isResign()) { actor->act(actor->getSearchAction()); }
     bool is_endgame = (actor->isResign() || actor->isEnvTerminal());
     bool display_game = (actor_id == 0 && (config::actor_num_simulation >= 50 || (config::actor_num_simulation < 50 && is_endgame)));
     if (display_game) { std::cerr << actor->getEnvironment().toString() << actor->getSearchInfo() << std::endl; }
     if (is_endgame) {
+        ++getSharedData()->num_finished_games_;
         getSharedData()->outputGame(actor);
         actor->reset();
     } else {
@@ -136,27 +267,59 @@ void ActorGroup::run()
     while (true) {
         handleCommand();
 
-        if (!running_) { continue; }
-        getSharedData()->actor_index_ = 0;
-        for (auto& t : slave_threads_) { t->start(); }
-        for (auto& t : slave_threads_) { t->finish(); }
-        getSharedData()->do_cpu_job_ = !getSharedData()->do_cpu_job_;
+        if (!running_) {
+            waitForCommand();
+            continue;
+        }
+        if (getSharedData()->is_async_) {
+            runAsyncRound();
+            continue;
+        }
+
+        // one cohort alternates between the search and the network evaluation, more cohorts overlap the search of the next cohort with the evaluation of the current one
+        int num_cohorts = getSharedData()->num_cohorts_;
+        int gpu_cohort = (num_cohorts == 1 ? (round_ % 2 == 1 ? 0 : -1) : round_ % num_cohorts);
+        int cpu_cohort = (num_cohorts == 1 ? (round_ % 2 == 0 ? 0 : -1) : (round_ + 1) % num_cohorts);
+        if (has_pending_batch_ && cpu_cohort != -1 && !commands_.empty()) {
+            // only evaluate the pending batch, so that the commands are handled when no batch is waiting for the networks
+            runRound(gpu_cohort, -1);
+        } else {
+            runRound(gpu_cohort, cpu_cohort);
+            round_ = (round_ + 1) % (2 * num_cohorts);
+        }
     }
 }
 
 void ActorGroup::initialize()
 {
     int num_threads = std::max(static_cast<int>(torch::cuda::device_count()), config::zero_num_threads);
-    createSlaveThreads(num_threads);
+    createSlaveThreads(num_threads, utils::getThreadCPUs(config::program_thread_affinity, num_threads));
+    getSharedData()->num_threads_ = num_threads;
+    getSharedData()->num_cohorts_ = std::max(1, std::min(config::zero_actor_num_cohorts, config::zero_num_parallel_games));
+    getSharedData()->gpu_cohort_ = getSharedData()->cpu_cohort_ = -1;
+    getSharedData()->gpu_busy_time_ = getSharedData()->cpu_busy_time_ = 0;
+    getSharedData()->num_finished_games_ = 0;
     createNeuralNetworks();
     createActors();
+    createNNCache();
+    createInferenceServices();
+    getSharedData()->record_writer_ = std::make_unique<GameRecordWriter>(std::cout);
+    getSharedData()->record_writer_->start();
     running_ = false;
-    getSharedData()->do_cpu_job_ = true;
+    round_ = 0;
+    has_pending_batch_ = false;
+    round_time_ = 0;
 
     // create one thread to handle I/O
-    commands_.clear();
     thread_groups_.create_thread(boost::bind(&ActorGroup::handleIO, this));
 
+    // create one thread to report the profile
+    if (config::zero_actor_profile_interval > 0) {
+        Profiler::enable();
+        getSharedData()->move_start_times_.resize(getSharedData()->actors_.size());
+        thread_groups_.create_thread(boost::bind(&ActorGroup::reportProfile, this));
+    }
+
     // initialize ignored command
     std::vector<std::string> ignored_commands = utils::stringToVector(config::zero_actor_ignored_command);
     for (const auto& command : ignored_commands) { ignored_commands_.insert(command); }
@@ -164,12 +327,20 @@ void ActorGroup::initialize()
 
 void ActorGroup::createNeuralNetworks()
 {
-    int num_networks = std::min(static_cast<int>(torch::cuda::device_count()), config::zero_num_parallel_games);
+    // without GPUs, each cohort has one network on the CPUs
+    int num_cohorts = getSharedData()->num_cohorts_;
+    int num_gpus = torch::cuda::device_count();
+    int num_networks = (num_gpus > 0 ? std::min(num_gpus, config::zero_num_parallel_games / num_cohorts) : 1);
     assert(num_networks > 0);
-    getSharedData()->networks_.resize(num_networks);
-    getSharedData()->network_outputs_.resize(num_networks);
-    for (int gpu_id = 0; gpu_id < num_networks; ++gpu_id) {
-        getSharedData()->networks_[gpu_id] = createNetwork(config::nn_file_name, gpu_id);
+    getSharedData()->networks_.resize(num_cohorts * num_networks);
+    getSharedData()->network_outputs_.resize(num_cohorts * num_networks);
+    for (int cohort = 0; cohort < num_cohorts; ++cohort) {
+        for (int gpu_id = 0; gpu_id < num_networks; ++gpu_id) {
+            getSharedData()->networks_[cohort * num_networks + gpu_id] = createNetwork(config::nn_file_name, (num_gpus > 0 ? gpu_id : -1));
+        }
+    }
+    for (auto& network : getSharedData()->networks_) {
+        if (network->getNetworkTypeName() == "alphazero") { std::static_pointer_cast<AlphaZeroNetwork>(network)->setDeduplicatingBatch(config::zero_actor_deduplicate_batch); }
     }
 }
 
@@ -177,9 +348,82 @@ void ActorGroup::createActors()
 {
     assert(getSharedData()->networks_.size() > 0);
     std::shared_ptr<Network>& network = getSharedData()->networks_[0];
-    uint64_t tree_node_size = static_cast<uint64_t>(config::actor_num_simulation + 1) * network->getActionSize();
-    for (int i = 0; i < config::zero_num_parallel_games; ++i) {
-        getSharedData()->actors_.emplace_back(createActor(tree_node_size, getSharedData()->networks_[i % getSharedData()->networks_.size()]));
+    uint64_t tree_node_size = MCTS::getTreeNodeSize(config::actor_num_simulation, network->getActionSize());
+    getSharedData()->actors_.resize(config::zero_num_parallel_games);
+    auto createThreadActors = [this, tree_node_size](int thread_id) {
+        for (int i = 0; i < config::zero_num_parallel_games; ++i) {
+            if (thread_id != -1 && getSharedData()->getActorThreadIndex(i) != thread_id) { continue; }
+            getSharedData()->actors_[i] = createActor(tree_node_size, getSharedData()->networks_[getSharedData()->getNetworkIndex(i)]);
+        }
+    };
+    if (slave_threads_[0]->getCPU() == -1) {
+        createThreadActors(-1);
+        return;
+    }
+
+    // create the actors on the CPUs of their threads, so that their memory (e.g., the trees) is first touched on the NUMA nodes running them
+    std::vector<int> thread_groups;
+    bool is_all_pinned = true;
+    for (size_t id = 0; id < slave_threads_.size(); ++id) {
+        int cpu = slave_threads_[id]->getCPU();
+        bool is_pinned = false;
+        std::thread([createThreadActors, id, cpu, &is_pinned]() {
+            is_pinned = pinCurrentThread(cpu);
+            createThreadActors(id);
+        }).join();
+        is_all_pinned = is_all_pinned && is_pinned;
+        thread_groups.push_back(getNUMANode(cpu));
+    }
+
+    // the actors are only stolen within the NUMA nodes if the threads actually run on them
+    if (!is_all_pinned) {
+        std::cerr << "Failed to pin the actor threads, the actors are stolen across NUMA nodes." << std::endl;
+        return;
+    }
+    getSharedData()->actor_ranges_.setThreadGroups(thread_groups);
+}
+
+void ActorGroup::createNNCache()
+{
+    // one cache shared by all actors, since the actors of different networks evaluate the same models
+    std::shared_ptr<ThreadSharedData> shared_data = getSharedData();
+    std::shared_ptr<Network>& network = shared_data->networks_[0];
+    if (config::zero_actor_nn_cache_size <= 0 || network->getNetworkTypeName() != "alphazero") { return; }
+
+    int64_t capacity = (static_cast<int64_t>(config::zero_actor_nn_cache_size) << 20) / NNCache::getEntryMemorySize(network->getActionSize());
+    shared_data->nn_cache_ = std::make_shared<NNCache>(std::min<int64_t>(capacity, INT32_MAX), 16 * shared_data->num_threads_);
+    for (auto& actor : shared_data->actors_) { actor->setNNCache(shared_data->nn_cache_); }
+    std::cerr << "NN cache capacity: " << shared_data->nn_cache_->getCapacity() << " evaluations" << std::endl;
+}
+
+void ActorGroup::createInferenceServices()
+{
+    // MuZero keeps the rounds, since its recurrent inference is batched with the hidden states of the parent nodes
+    std::shared_ptr<ThreadSharedData> shared_data = getSharedData();
+    shared_data->is_async_ = (config::zero_actor_inference_max_batch_size > 0 && shared_data->networks_[0]->getNetworkTypeName() == "alphazero");
+    shared_data->is_paused_ = true;
+
+    // reserve the network inputs for the largest batch, i.e., the leaves of all actors sharing a network in a round, or the requests of an inference service
+    const int num_networks = shared_data->networks_.size();
+    const int num_actors_per_network = (config::zero_num_parallel_games + num_networks - 1) / num_networks;
+    const int max_batch_size = (shared_data->is_async_ ? std::min(num_actors_per_network, config::zero_actor_inference_max_batch_size) : num_actors_per_network * config::actor_mcts_self_play_batch_size);
+    for (auto& network : shared_data->networks_) { network->reserveBatchSize(max_batch_size); }
+    if (!shared_data->is_async_) { return; }
+
+    // the completed requests are passed back to the threads running their actors
+    const int num_threads = slave_threads_.size();
+    ThreadSharedData* data = shared_data.get();
+    auto on_complete = [data](InferenceRequest* request) { data->actor_requests_[data->getActorThreadIndex(request->id_)]->complete(request); };
+    for (auto& network : shared_data->networks_) {
+        shared_data->inference_services_.emplace_back(std::make_unique<InferenceService>(std::static_pointer_cast<AlphaZeroNetwork>(network), config::zero_actor_inference_max_batch_size, config::zero_actor_inference_timeout, on_complete));
+        shared_data->inference_services_.back()->start();
+    }
+    for (int id = 0; id < num_threads; ++id) { shared_data->actor_requests_.emplace_back(std::make_unique<ActorRequestQueue>()); }
+    for (size_t actor_id = 0; actor_id < shared_data->actors_.size(); ++actor_id) {
+        std::shared_ptr<Network>& network = shared_data->networks_[shared_data->getNetworkIndex(actor_id)];
+        shared_data->requests_.emplace_back(std::make_unique<InferenceRequest>(actor_id, network->getNumInputChannels() * network->getInputChannelHeight() * network->getInputChannelWidth()));
+        shared_data->actors_[actor_id]->setNNEvaluationInput(shared_data->requests_.back()->features_.data());
+        shared_data->actor_requests_[shared_data->getActorThreadIndex(actor_id)]->push(shared_data->requests_.back().get());
     }
 }
 
@@ -189,20 +433,25 @@ void ActorGroup::handleIO()
     const int buffer_size = 10000000;
     command.reserve(buffer_size);
     while (getline(std::cin, command)) {
-        std::lock_guard lock(getSharedData()->mutex_);
-        commands_.push_back(command);
+        // copy the command so that the reserved buffer is kept, and wait for the main thread if the queue is full
+        while (!commands_.tryPush(std::string(command))) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+        std::lock_guard lock(command_mutex_);
+        command_cv_.notify_one();
     }
 }
 
-void ActorGroup::handleCommand()
+void ActorGroup::waitForCommand()
 {
-    if (commands_.empty() || !getSharedData()->do_cpu_job_) { return; }
+    std::unique_lock lock(command_mutex_);
+    command_cv_.wait(lock, [this] { return !commands_.empty(); });
+}
 
-    std::lock_guard lock(getSharedData()->mutex_);
-    while (!commands_.empty()) {
-        const std::string command = commands_.front();
-        commands_.pop_front();
+void ActorGroup::handleCommand()
+{
+    if (commands_.empty() || has_pending_batch_) { return; }
 
+    std::string command;
+    while (commands_.tryPop(command)) {
         // ignore specific command
         std::string command_prefix = ((command.find(" ") == std::string::npos) ? command : command.substr(0, command.find(" ")));
         if (ignored_commands_.count(command_prefix)) {
@@ -220,13 +469,14 @@ void ActorGroup::handleCommand(const std::string& command_prefix, const std::str
     if (command_prefix == "reset_actors") {
         std::cerr << "[command] " << command << std::endl;
         for (auto& actor : getSharedData()->actors_) { actor->reset(); }
-        getSharedData()->do_cpu_job_ = true;
+        round_ = 0;
     } else if (command_prefix == "load_model") {
         std::cerr << "[command] " << command << std::endl;
         std::vector<std::string> args = utils::stringToVector(command);
         assert(args.size() == 2);
         config::nn_file_name = args[1];
-        for (auto& network : getSharedData()->networks_) { network->loadModel(config::nn_file_name, network->getGPUID()); }
+        reportPerformance();
+        for (auto& network : getSharedData()->networks_) { network->loadShadowModel(config::nn_file_name); }
     } else if (command_prefix == "update_config") {
         std::cerr << "[command] " << command << std::endl;
         assert(command.find(" ") != std::string::npos);
@@ -239,13 +489,109 @@ void ActorGroup::handleCommand(const std::string& command_prefix, const std::str
     } else if (command_prefix == "start") {
         std::cerr << "[command] " << command << std::endl;
         running_ = true;
+        std::fill(getSharedData()->move_start_times_.begin(), getSharedData()->move_start_times_.end(), std::chrono::steady_clock::now()); // not to count the stopped time in the move latencies
     } else if (command_prefix == "stop") {
         std::cerr << "[command] " << command << std::endl;
         running_ = false;
+        reportPerformance();
     } else if (command_prefix == "quit") {
         std::cerr << "[command] " << command << std::endl;
+        getSharedData()->record_writer_->stop();
         exit(0);
     }
 }
 
+void ActorGroup::runRound(int gpu_cohort, int cpu_cohort)
+{
+    auto start_time = std::chrono::steady_clock::now();
+    getSharedData()->gpu_cohort_ = gpu_cohort;
+    getSharedData()->cpu_cohort_ = cpu_cohort;
+    if (cpu_cohort != -1) {
+        int num_cohort_actors = (getSharedData()->actors_.size() - cpu_cohort + getSharedData()->num_cohorts_ - 1) / getSharedData()->num_cohorts_;
+        getSharedData()->actor_ranges_.reset(slave_threads_.size(), num_cohort_actors);
+    }
+    for (auto& t : slave_threads_) { t->start(); }
+    for (auto& t : slave_threads_) { t->finish(); }
+    has_pending_batch_ = (cpu_cohort != -1);
+    round_time_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void ActorGroup::runAsyncRound()
+{
+    // the slave threads keep running the actors with the inference services until a command arrives
+    auto start_time = std::chrono::steady_clock::now();
+    getSharedData()->is_paused_ = false;
+    for (auto& t : slave_threads_) { t->start(); }
+    waitForCommand();
+    getSharedData()->is_paused_ = true;
+    for (auto& actor_requests : getSharedData()->actor_requests_) { actor_requests->wake(); }
+    for (auto& t : slave_threads_) { t->finish(); }
+    has_pending_batch_ = false;
+    round_time_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void ActorGroup::reportPerformance()
+{
+    // the busy fractions since the last report, compare runs with zero_actor_num_cohorts = 1 (lock-step) and >= 2 (pipelined)
+    if (round_time_ == 0) { return; }
+
+    std::shared_ptr<ThreadSharedData> shared_data = getSharedData();
+    int64_t gpu_busy_time = shared_data->gpu_busy_time_;
+    int64_t num_batches = 0, num_requests = 0;
+    for (auto& service : shared_data->inference_services_) {
+        gpu_busy_time += service->getBusyTime();
+        num_batches += service->getNumBatches();
+        num_requests += service->getNumRequests();
+        service->resetStatistics();
+    }
+    double gpu_busy = static_cast<double>(gpu_busy_time) / (round_time_ * shared_data->getNumNetworksPerCohort());
+    double cpu_busy = static_cast<double>(shared_data->cpu_busy_time_) / (round_time_ * slave_threads_.size());
+    double games_per_hour = shared_data->num_finished_games_ * 3600.0 * 1e6 / round_time_;
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2)
+        << "[performance] cohorts: " << shared_data->num_cohorts_
+        << ", GPU busy: " << gpu_busy * 100 << "%"
+        << ", CPU busy: " << cpu_busy * 100 << "%"
+        << ", games per hour: " << games_per_hour;
+    if (num_batches > 0) { oss << ", average batch size: " << static_cast<double>(num_requests) / num_batches; }
+    int64_t num_deduplicated_batches = 0, num_deduplicated_inputs = 0, num_unique_inputs = 0;
+    for (auto& network : shared_data->networks_) {
+        if (network->getNetworkTypeName() != "alphazero") { continue; }
+        std::shared_ptr<AlphaZeroNetwork> alphazero_network = std::static_pointer_cast<AlphaZeroNetwork>(network);
+        num_deduplicated_batches += alphazero_network->getNumDeduplicatedBatches();
+        num_deduplicated_inputs += alphazero_network->getNumDeduplicatedInputs();
+        num_unique_inputs += alphazero_network->getNumUniqueInputs();
+        alphazero_network->resetDeduplicationStatistics();
+    }
+    if (num_deduplicated_batches > 0) {
+        oss << ", dedup ratio: " << 100.0 * (num_deduplicated_inputs - num_unique_inputs) / num_deduplicated_inputs << "%"
+            << " (" << static_cast<double>(num_unique_inputs) / num_deduplicated_batches << " unique of " << static_cast<double>(num_deduplicated_inputs) / num_deduplicated_batches << " inputs per batch)";
+    }
+    if (shared_data->nn_cache_) {
+        int64_t num_lookups = shared_data->nn_cache_->getNumLookups();
+        oss << ", NN cache hit rate: " << (num_lookups > 0 ? 100.0 * shared_data->nn_cache_->getNumHits() / num_lookups : 0.0) << "%";
+        shared_data->nn_cache_->resetStatistics();
+    }
+    std::cerr << oss.str() << std::endl;
+
+    shared_data->gpu_busy_time_ = shared_data->cpu_busy_time_ = 0;
+    shared_data->num_finished_games_ = 0;
+    round_time_ = 0;
+}
+
+void ActorGroup::reportProfile()
+{
+    // the profile since the last report, one JSON line each zero_actor_profile_interval seconds
+    std::ofstream fout;
+    if (!config::zero_actor_profile_file.empty()) { fout.open(config::zero_actor_profile_file, std::ofstream::app); }
+    while (true) {
+        boost::this_thread::sleep(boost::posix_time::seconds(config::zero_actor_profile_interval));
+        if (fout.is_open()) {
+            fout << Profiler::report() << std::endl;
+        } else {
+            std::cerr << "[profile] " << Profiler::report() << std::endl;
+        }
+    }
+}
+
 } // namespace minizero::actor
@@ -1,9 +1,17 @@
 #pragma once
 
 #include "base_actor.h"
+#include "game_record_writer.h"
+#include "inference_service.h"
+#include "mpsc_queue.h"
 #include "network.h"
+#include "nn_cache.h"
 #include "paralleler.h"
-#include <deque>
+#include "spsc_queue.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -13,18 +21,66 @@
 
 namespace minizero::actor {
 
+// the requests of the actors run by a slave thread, which sleeps until one of them is completed or the actor group pauses
+// the requests are pushed by the inference services, and popped by the slave thread only
+class ActorRequestQueue {
+public:
+    ActorRequestQueue()
+        : num_ready_requests_(0),
+          num_inflight_requests_(0),
+          is_waiting_(false) {}
+
+    void push(network::InferenceRequest* request);
+    void submit(network::InferenceRequest* request, network::InferenceService& service);
+    void complete(network::InferenceRequest* request);
+    network::InferenceRequest* pop(const std::atomic<bool>& is_paused);
+    void waitForInflightRequests();
+    void wake();
+
+private:
+    void notify();
+
+    utils::MPSCQueue<network::InferenceRequest> queue_;
+    std::atomic<int> num_ready_requests_;
+    std::atomic<int> num_inflight_requests_;
+    std::atomic<bool> is_waiting_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+// the actors are split into cohorts (actor i belongs to cohort i % num_cohorts_), each cohort has its own network on every GPU
+// in each round, the networks evaluate the batch of gpu_cohort_ while the slave threads run the actors of cpu_cohort_
+// with inference services (is_async_), each network is served by its own thread and the actors run without rounds until the group pauses
 class ThreadSharedData : public utils::BaseSharedData {
 public:
-    int getAvailableActorIndex();
+    int getAvailableActorIndex(int thread_id);
     void outputGame(const std::shared_ptr<BaseActor>& actor);
     std::pair<int, int> calculateTrainingDataRange(const std::shared_ptr<BaseActor>& actor);
 
-    bool do_cpu_job_;
-    int actor_index_;
-    std::mutex mutex_;
+    inline int getNumNetworksPerCohort() const { return networks_.size() / num_cohorts_; }
+    inline int getNetworkIndex(int actor_id) const { return (actor_id % num_cohorts_) * getNumNetworksPerCohort() + (actor_id / num_cohorts_) % getNumNetworksPerCohort(); }
+    int getActorThreadIndex(int actor_id) const;
+
+    int num_threads_;
+    int num_cohorts_;
+    int gpu_cohort_; // -1 for no network evaluation in this round
+    int cpu_cohort_; // -1 for no search in this round
+    utils::WorkStealingRanges actor_ranges_;
+    std::atomic<int64_t> gpu_busy_time_; // in microseconds
+    std::atomic<int64_t> cpu_busy_time_; // in microseconds
+    std::atomic<int> num_finished_games_;
+    std::vector<std::chrono::steady_clock::time_point> move_start_times_; // one per actor, only kept when profiling
+    std::unique_ptr<GameRecordWriter> record_writer_;
     std::vector<std::shared_ptr<BaseActor>> actors_;
     std::vector<std::shared_ptr<network::Network>> networks_;
     std::vector<std::vector<std::shared_ptr<network::NetworkOutput>>> network_outputs_;
+    std::shared_ptr<network::NNCache> nn_cache_; // nullptr if disabled
+
+    bool is_async_;
+    std::atomic<bool> is_paused_;
+    std::vector<std::unique_ptr<network::InferenceRequest>> requests_;           // one per actor
+    std::vector<std::unique_ptr<network::InferenceService>> inference_services_; // one per network
+    std::vector<std::unique_ptr<ActorRequestQueue>> actor_requests_;             // one per slave thread, actor i is run by thread getActorThreadIndex(i)
 };
 
 class SlaveThread : public utils::BaseSlaveThread {
@@ -38,14 +94,16 @@ public:
 
 protected:
     virtual bool doCPUJob();
-    virtual void doGPUJob();
+    virtual bool doGPUJob();
+    virtual void runActorsAsync();
     virtual void handleSearchDone(int actor_id);
     inline std::shared_ptr<ThreadSharedData> getSharedData() { return std::static_pointer_cast<ThreadSharedData>(shared_data_); }
 };
 
 class ActorGroup : public utils::BaseParalleler {
 public:
-    ActorGroup() {}
+    ActorGroup()
+        : commands_(1024) {}
 
     void run();
     void initialize() override;
@@ -54,16 +112,28 @@ public:
 protected:
     virtual void createNeuralNetworks();
     virtual void createActors();
+    virtual void createNNCache();
+    virtual void createInferenceServices();
     virtual void handleIO();
+    virtual void waitForCommand();
     virtual void handleCommand();
     virtual void handleCommand(const std::string& command_prefix, const std::string& command);
+    virtual void runRound(int gpu_cohort, int cpu_cohort);
+    virtual void runAsyncRound();
+    virtual void reportPerformance();
+    virtual void reportProfile();
 
     void createSharedData() override { shared_data_ = std::make_shared<ThreadSharedData>(); }
     std::shared_ptr<utils::BaseSlaveThread> newSlaveThread(int id) override { return std::make_shared<SlaveThread>(id, shared_data_); }
     inline std::shared_ptr<ThreadSharedData> getSharedData() { return std::static_pointer_cast<ThreadSharedData>(shared_data_); }
 
     bool running_;
-    std::deque<std::string> commands_;
+    int round_;
+    bool has_pending_batch_;
+    int64_t round_time_;                     // in microseconds
+    utils::SPSCQueue<std::string> commands_; // pushed by the I/O thread and popped by the main thread
+    std::mutex command_mutex_;               // only for waking the main thread when a command arrives
+    std::condition_variable command_cv_;
     std::unordered_set<std::string> ignored_commands_;
 };
 
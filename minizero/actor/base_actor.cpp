@@ -39,11 +39,13 @@ bool BaseActor::act(const std::vector<std::string>& action_string_args)
     return can_act;
 }
 
-std::string BaseActor::getRecord(const std::unordered_map<std::string, std::string>& tags /* = {} */) const
+EnvironmentLoader BaseActor::getRecordLoader(const std::unordered_map<std::string, std::string>& tags /* = {} */, bool defer_observation_compression /* = false */) const
 {
     EnvironmentLoader env_loader;
+    env_loader.setDeferObservationCompression(defer_observation_compression);
     env_loader.loadFromEnvironment(env_, action_info_history_);
-    env_loader.addTag("EV", config::nn_file_name.substr(config::nn_file_name.find_last_of('/') + 1));
+    const std::string& nn_file_name = (nn_evaluation_model_ ? nn_evaluation_model_->file_name_ : config::nn_file_name);
+    env_loader.addTag("EV", nn_file_name.substr(nn_file_name.find_last_of('/') + 1));
 
     // if the game is not ended, then treat the game as a resign game, where the next player is the lose side
     if (!isEnvTerminal()) {
@@ -53,7 +55,7 @@ std::string BaseActor::getRecord(const std::unordered_map<std::string, std::stri
         env_loader.addTag("RE", oss.str());
     }
     for (auto tag : tags) { env_loader.addTag(tag.first, tag.second); }
-    return env_loader.toString();
+    return env_loader;
 }
 
 std::vector<std::pair<std::string, std::string>> BaseActor::getActionInfo() const
@@ -2,6 +2,7 @@
 
 #include "environment.h"
 #include "network.h"
+#include "nn_cache.h"
 #include "search.h"
 #include <memory>
 #include <string>
@@ -15,26 +16,33 @@ using namespace minizero;
 
 class BaseActor {
 public:
-    BaseActor() {}
+    BaseActor()
+        : nn_evaluation_input_(nullptr), nn_cache_(nullptr), nn_evaluation_model_(nullptr) {}
     virtual ~BaseActor() = default;
 
     virtual void reset();
     virtual void resetSearch();
     bool act(const Action& action);
     bool act(const std::vector<std::string>& action_string_args);
-    virtual std::string getRecord(const std::unordered_map<std::string, std::string>& tags = {}) const;
+    virtual std::string getRecord(const std::unordered_map<std::string, std::string>& tags = {}) const { return getRecordLoader(tags).toString(); }
+    virtual EnvironmentLoader getRecordLoader(const std::unordered_map<std::string, std::string>& tags = {}, bool defer_observation_compression = false) const;
 
     inline bool isEnvTerminal() const { return env_.isTerminal(); }
     inline const float getEvalScore() const { return env_.getEvalScore(); }
     inline Environment& getEnvironment() { return env_; }
     inline const Environment& getEnvironment() const { return env_; }
     inline const int getNNEvaluationBatchIndex() const { return nn_evaluation_batch_id_; }
+    inline void setNNEvaluationInput(float* nn_evaluation_input) { nn_evaluation_input_ = nn_evaluation_input; }
+    inline void setNNCache(const std::shared_ptr<network::NNCache>& nn_cache) { nn_cache_ = nn_cache; }
+    inline network::NetworkModel* getNNEvaluationModel() const { return nn_evaluation_model_.get(); }
     inline std::vector<std::vector<std::pair<std::string, std::string>>>& getActionInfoHistory() { return action_info_history_; }
     inline const std::vector<std::vector<std::pair<std::string, std::string>>>& getActionInfoHistory() const { return action_info_history_; }
 
     virtual Action think(bool with_play = false, bool display_board = false) = 0;
     virtual void beforeNNEvaluation() = 0;
     virtual void afterNNEvaluation(const std::shared_ptr<network::NetworkOutput>& network_output) = 0;
+    virtual void beforeNNEvaluationBatch(int max_num_leaves) { beforeNNEvaluation(); } // submit up to max_num_leaves leaves to the network batch
+    virtual void afterNNEvaluationBatch(const std::vector<std::shared_ptr<network::NetworkOutput>>& network_outputs) { afterNNEvaluation(network_outputs[nn_evaluation_batch_id_]); }
     virtual bool isSearchDone() const = 0;
     virtual Action getSearchAction() const = 0;
     virtual bool isResign() const = 0;
@@ -49,6 +57,9 @@ protected:
     virtual std::string getEnvReward() const = 0;
 
     int nn_evaluation_batch_id_;
+    float* nn_evaluation_input_; // if set, e.g., by an inference service, the features are written here instead of to the network batch
+    std::shared_ptr<network::NNCache> nn_cache_; // if set, e.g., by the actor group, the evaluations are shared with the other actors
+    std::shared_ptr<network::NetworkModel> nn_evaluation_model_; // the model of the current search, taken from the network when the search starts
     Environment env_;
     std::shared_ptr<Search> search_;
     std::vector<std::vector<std::pair<std::string, std::string>>> action_info_history_;
@@ -0,0 +1,72 @@
+#include "game_record_writer.h"
+#include <sstream>
+
+namespace minizero::actor {
+
+GameRecordWriter::GameRecordWriter(std::ostream& os)
+    : os_(os),
+      num_queued_records_(0),
+      is_waiting_(false),
+      is_stopped_(true)
+{
+}
+
+void GameRecordWriter::start()
+{
+    if (!is_stopped_) { return; }
+    is_stopped_ = false;
+    thread_ = std::thread(&GameRecordWriter::run, this);
+}
+
+void GameRecordWriter::stop()
+{
+    // the records handed off before stopping are still written
+    if (is_stopped_) { return; }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_stopped_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void GameRecordWriter::write(std::unique_ptr<GameRecord> record)
+{
+    queue_.push(record.release());
+    ++num_queued_records_;
+
+    // only wake the writer thread when it sleeps, the check after the increment cannot miss a thread that is going to sleep
+    if (is_waiting_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_one();
+    }
+}
+
+void GameRecordWriter::run()
+{
+    while (waitForRecords()) {
+        std::ostringstream oss;
+        while (num_queued_records_ > 0) {
+            std::unique_ptr<GameRecord> record(queue_.pop());
+            if (!record) { break; } // the record is being pushed, write it in the next batch
+            --num_queued_records_;
+
+            record->env_loader_.compressObservations();
+            oss << record->header_ << " " << record->env_loader_.toString() << " #\n";
+        }
+        os_ << oss.str() << std::flush;
+    }
+}
+
+bool GameRecordWriter::waitForRecords()
+{
+    // return false if the writer is stopped and all records are written
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto can_wake = [this] { return num_queued_records_ > 0 || is_stopped_; };
+    is_waiting_ = true;
+    cv_.wait(lock, can_wake);
+    is_waiting_ = false;
+    return num_queued_records_ > 0;
+}
+
+} // namespace minizero::actor
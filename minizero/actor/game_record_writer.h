@@ -0,0 +1,47 @@
+#pragma once
+
+#include "environment.h"
+#include "mpsc_queue.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+namespace minizero::actor {
+
+// a finished (or intermediate) game handed off by an actor, the observations are compressed by the writer
+class GameRecord : public utils::MPSCQueueNode {
+public:
+    std::string header_; // the fields before the record, e.g., "SelfPlay true 10 10 1"
+    EnvironmentLoader env_loader_;
+};
+
+// compresses, formats and writes the game records on a dedicated thread, any thread can hand off records without locks
+// the records queued at the same time are written together with a single flush
+class GameRecordWriter {
+public:
+    GameRecordWriter(std::ostream& os);
+    ~GameRecordWriter() { stop(); }
+
+    void start();
+    void stop();
+    void write(std::unique_ptr<GameRecord> record);
+
+protected:
+    void run();
+    bool waitForRecords();
+
+    std::ostream& os_;
+    utils::MPSCQueue<GameRecord> queue_;
+    std::atomic<int> num_queued_records_;
+    std::atomic<bool> is_waiting_;
+    std::atomic<bool> is_stopped_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
+
+} // namespace minizero::actor
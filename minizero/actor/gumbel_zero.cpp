@@ -19,11 +19,11 @@ std::string GumbelZero::getMCTSPolicy(const std::shared_ptr<MCTS>& mcts) const
     }
     float value_pi = mcts->getRootNode()->getValue();
     if (config::actor_mcts_value_rescale) {
-        if (mcts->getTreeValueBound().size() < 2) {
+        if (!mcts->getTreeValueBound().hasBound()) {
             value_pi = 1.0f;
         } else {
-            const float value_lower_bound = mcts->getTreeValueBound().begin()->first;
-            const float value_upper_bound = mcts->getTreeValueBound().rbegin()->first;
+            const float value_lower_bound = mcts->getTreeValueBound().getLowerBound();
+            const float value_upper_bound = mcts->getTreeValueBound().getUpperBound();
             value_pi = (value_pi - value_lower_bound) / (value_upper_bound - value_lower_bound);
             value_pi = fmin(1, fmax(-1, 2 * value_pi - 1));
         }
@@ -90,13 +90,7 @@ std::vector<MCTSNode*> GumbelZero::selection(const std::shared_ptr<MCTS>& mcts)
 void GumbelZero::sequentialHalving(const std::shared_ptr<MCTS>& mcts)
 {
     if (mcts->getNumSimulation() == 1) {
-        // collect candidates
-        candidates_.clear();
-        for (int i = 0; i < mcts->getRootNode()->getNumChildren(); ++i) { candidates_.push_back(mcts->getRootNode()->getChild(i)); }
-        sort(candidates_.begin(), candidates_.end(), [](const MCTSNode* lhs, const MCTSNode* rhs) { return lhs->getPolicyLogit() > rhs->getPolicyLogit(); });
-        if (static_cast<int>(candidates_.size()) > config::actor_gumbel_sample_size) { candidates_.resize(config::actor_gumbel_sample_size); }
-        sample_size_ = config::actor_gumbel_sample_size;
-        simulation_budget_ = std::max(1.0, std::floor(config::actor_num_simulation / (std::log2(config::actor_gumbel_sample_size) * sample_size_)));
+        initializeCandidates(mcts);
     } else {
         bool all_candidates_reach_budget = true;
         for (auto node : candidates_) {
@@ -118,6 +112,19 @@ void GumbelZero::sequentialHalving(const std::shared_ptr<MCTS>& mcts)
     }
 }
 
+void GumbelZero::initializeCandidates(const std::shared_ptr<MCTS>& mcts)
+{
+    // collect candidates, the budget starts from the least visited candidate since the root may be reused from the previous search
+    candidates_.clear();
+    for (int i = 0; i < mcts->getRootNode()->getNumChildren(); ++i) { candidates_.push_back(mcts->getRootNode()->getChild(i)); }
+    sort(candidates_.begin(), candidates_.end(), [](const MCTSNode* lhs, const MCTSNode* rhs) { return lhs->getPolicyLogit() > rhs->getPolicyLogit(); });
+    if (static_cast<int>(candidates_.size()) > config::actor_gumbel_sample_size) { candidates_.resize(config::actor_gumbel_sample_size); }
+    sample_size_ = config::actor_gumbel_sample_size;
+    float min_count = std::numeric_limits<float>::max();
+    for (auto node : candidates_) { min_count = std::min(min_count, node->getCount()); }
+    simulation_budget_ = min_count + std::max(1.0, std::floor(config::actor_num_simulation / (std::log2(config::actor_gumbel_sample_size) * sample_size_)));
+}
+
 void GumbelZero::sortCandidatesByScore(const std::shared_ptr<MCTS>& mcts)
 {
     assert(!candidates_.empty());
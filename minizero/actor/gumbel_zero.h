@@ -13,6 +13,7 @@ public:
     MCTSNode* decideActionNode(const std::shared_ptr<MCTS>& mcts);
     std::vector<MCTSNode*> selection(const std::shared_ptr<MCTS>& mcts);
     void sequentialHalving(const std::shared_ptr<MCTS>& mcts);
+    void initializeCandidates(const std::shared_ptr<MCTS>& mcts);
     void sortCandidatesByScore(const std::shared_ptr<MCTS>& mcts);
 
 private:
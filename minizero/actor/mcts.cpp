@@ -6,79 +6,147 @@ void MCTSNode::reset()
 {
     num_children_ = 0;
     hidden_state_data_index_ = -1;
-    mean_ = 0.0f;
-    count_ = 0.0f;
-    virtual_loss_ = 0.0f;
-    policy_ = 0.0f;
+    action_candidate_index_ = -1;
+    num_action_candidates_ = 0;
+    setMean(0.0f);
+    setCount(0.0f);
+    node_store_->getVirtualLoss()[node_store_->getIndex(this)] = 0.0f;
+    setPolicy(0.0f);
     policy_logit_ = 0.0f;
     policy_noise_ = 0.0f;
     value_ = 0.0f;
-    reward_ = 0.0f;
+    setReward(0.0f);
     first_child_ = nullptr;
+    update_lock_ = false;
+    expansion_lock_ = false;
 }
 
 void MCTSNode::add(float value, float weight /* = 1.0f */)
 {
-    if (count_ + weight <= 0) {
+    const float count = getCount();
+    if (count + weight <= 0) {
         reset();
     } else {
-        count_ += weight;
-        mean_ += weight * (value - mean_) / count_;
+        setCount(count + weight);
+        setMean(getMean() + weight * (value - getMean()) / (count + weight));
     }
 }
 
 void MCTSNode::remove(float value, float weight /* = 1.0f */)
 {
-    if (count_ - weight <= 0) {
+    const float count = getCount();
+    if (count - weight <= 0) {
         reset();
     } else {
-        count_ -= weight;
-        mean_ -= weight * (value - mean_) / count_;
+        setCount(count - weight);
+        setMean(getMean() - weight * (value - getMean()) / (count - weight));
     }
 }
 
-float MCTSNode::getNormalizedMean(const std::map<float, int>& tree_value_bound) const
+void MCTSNode::addAtomic(float value, float weight /* = 1.0f */)
 {
-    float value = reward_ + config::actor_mcts_reward_discount * mean_;
-    if (config::actor_mcts_value_rescale) {
-        if (tree_value_bound.size() < 2) { return 1.0f; }
-        const float value_lower_bound = tree_value_bound.begin()->first;
-        const float value_upper_bound = tree_value_bound.rbegin()->first;
-        value = (value - value_lower_bound) / (value_upper_bound - value_lower_bound);
-        value = fmin(1, fmax(-1, 2 * value - 1)); // normalize to [-1, 1]
-    }
-    value = (action_.getPlayer() == env::charToPlayer(config::actor_mcts_value_flipping_player) ? -value : value); // flip value according to player
-    value = (value * count_ - virtual_loss_) / getCountWithVirtualLoss();    // value with virtual loss
-    return value;
+    assert(weight > 0);
+    while (__atomic_test_and_set(&update_lock_, __ATOMIC_ACQUIRE)) {}
+    const float count = getCount() + weight;
+    setCount(count);
+    setMean(getMean() + weight * (value - getMean()) / count);
+    __atomic_clear(&update_lock_, __ATOMIC_RELEASE);
+}
+
+float MCTSNode::getNormalizedMean(const TreeValueBound& tree_value_bound) const
+{
+    bool flip_value = (action_.getPlayer() == env::charToPlayer(config::actor_mcts_value_flipping_player));
+    return getNormalizedMean(getReward(), getMean(), getCount(), getVirtualLoss(), getPUCTParameters(0, flip_value, tree_value_bound));
 }
 
-float MCTSNode::getNormalizedPUCTScore(int total_simulation, const std::map<float, int>& tree_value_bound, float init_q_value /* = -1.0f */) const
+float MCTSNode::getNormalizedPUCTScore(int total_simulation, const TreeValueBound& tree_value_bound, float init_q_value /* = -1.0f */) const
 {
-    float puct_bias = config::actor_mcts_puct_init + log((1 + total_simulation + config::actor_mcts_puct_base) / config::actor_mcts_puct_base);
-    float value_u = (puct_bias * getPolicy() * sqrt(total_simulation)) / (1 + getCountWithVirtualLoss());
     float value_q = (getCountWithVirtualLoss() == 0 ? init_q_value : getNormalizedMean(tree_value_bound));
-    return value_u + value_q;
+    return getPUCTScore(getPUCTBias(getPUCTParameters(total_simulation, false, tree_value_bound)), sqrt(total_simulation), getPolicy(), getCountWithVirtualLoss(), value_q);
+}
+
+PUCTParameters MCTSNode::getPUCTParameters(int total_simulation, bool flip_value, const TreeValueBound& tree_value_bound)
+{
+    PUCTParameters parameters;
+    parameters.total_simulation_ = total_simulation;
+    parameters.puct_init_ = config::actor_mcts_puct_init;
+    parameters.puct_base_ = config::actor_mcts_puct_base;
+    parameters.reward_discount_ = config::actor_mcts_reward_discount;
+    parameters.flip_value_ = flip_value;
+    parameters.value_rescale_ = config::actor_mcts_value_rescale;
+    parameters.has_value_bound_ = tree_value_bound.hasBound();
+    parameters.value_lower_bound_ = (parameters.has_value_bound_ ? tree_value_bound.getLowerBound() : 0.0f);
+    parameters.value_upper_bound_ = (parameters.has_value_bound_ ? tree_value_bound.getUpperBound() : 0.0f);
+    return parameters;
 }
 
 std::string MCTSNode::toString() const
 {
     std::ostringstream oss;
     oss.precision(4);
-    oss << std::fixed << "p = " << policy_
+    oss << std::fixed << "p = " << getPolicy()
         << ", p_logit = " << policy_logit_
         << ", p_noise = " << policy_noise_
         << ", v = " << value_
-        << ", r = " << reward_
-        << ", mean = " << mean_
-        << ", count = " << count_;
+        << ", r = " << getReward()
+        << ", mean = " << getMean()
+        << ", count = " << getCount();
     return oss.str();
 }
 
+void MCTSNodeStore::allocate(MCTSNode* nodes, uint64_t size)
+{
+    release();
+    size_ = size;
+    nodes_ = nodes;
+    policy_ = allocateArray(size);
+    count_ = allocateArray(size);
+    mean_ = allocateArray(size);
+    virtual_loss_ = allocateArray(size);
+    reward_ = allocateArray(size);
+}
+
+void MCTSNodeStore::copy(const MCTSNode* source, const MCTSNode* destination)
+{
+    const uint64_t source_index = getIndex(source), destination_index = getIndex(destination);
+    for (float* array : {policy_, count_, mean_, virtual_loss_, reward_}) { array[destination_index] = array[source_index]; }
+}
+
+void MCTSNodeStore::release()
+{
+    for (float* array : {policy_, count_, mean_, virtual_loss_, reward_}) { std::free(array); }
+    size_ = 0;
+    nodes_ = nullptr;
+    policy_ = count_ = mean_ = virtual_loss_ = reward_ = nullptr;
+}
+
+float* MCTSNodeStore::allocateArray(uint64_t size)
+{
+    // align each array to the cache line, std::aligned_alloc requires the size to be a multiple of the alignment
+    const uint64_t cache_line_size = 64;
+    uint64_t num_bytes = (size * sizeof(float) + cache_line_size - 1) / cache_line_size * cache_line_size;
+    float* array = static_cast<float*>(std::aligned_alloc(cache_line_size, num_bytes));
+    assert(array);
+    return array;
+}
+
 void MCTS::reset()
 {
     Tree::reset();
     tree_hidden_state_data_.reset();
     tree_value_bound_.clear();
+    tree_action_priors_.clear();
+}
+
+uint64_t MCTS::getTreeNodeSize(int num_simulation, int action_size)
+{
+    // each simulation expands at most one node with at most action_size children
+    if (!config::actor_mcts_lazy_expansion) { return static_cast<uint64_t>(num_simulation + 1) * action_size; }
+
+    // each simulation expands at most one node and materializes at most two children, one selected and the first child of the expanded leaf
+    // the blocks of a lazily expanded node with m children sum up to at most 8 + 4m nodes (see getChildrenCapacity)
+    // the root is fully expanded, and a reused root is fully materialized before its subtree is compacted
+    return 3 * static_cast<uint64_t>(action_size) + 16 * static_cast<uint64_t>(num_simulation + 1);
 }
 
 bool MCTS::isResign(const MCTSNode* selected_node) const
@@ -142,7 +210,17 @@ std::vector<MCTSNode*> MCTS::selectFromNode(MCTSNode* start_node)
     MCTSNode* node = start_node;
     std::vector<MCTSNode*> node_path{node};
     while (!node->isLeaf()) {
-        node = selectChildByPUCTScore(node);
+        MCTSNode* selected = selectChildByPUCTScore(node);
+        if (!node->isFullyExpanded()) {
+            // the first unmaterialized candidate has the highest policy among the unvisited candidates, so it is the only one that can beat the selected child
+            int total_simulation = node->getCountWithVirtualLoss() - 1;
+            float init_q_value = calculateInitQValue(node);
+            float selected_score = selected->getNormalizedPUCTScore(total_simulation, tree_value_bound_, init_q_value);
+            const ActionPrior& candidate = tree_action_priors_[node->getActionCandidateIndex() + node->getNumChildren() - 1];
+            float candidate_score = MCTSNode::getPUCTScore(MCTSNode::getPUCTBias(getPUCTParameters(node)), sqrt(total_simulation), candidate.policy_, 0.0f, init_q_value);
+            if (candidate_score > selected_score || (candidate_score == selected_score && candidate.policy_ > selected->getPolicy())) { selected = materializeChild(node); }
+        }
+        node = selected;
         node_path.push_back(node);
     }
     return node_path;
@@ -151,16 +229,33 @@ std::vector<MCTSNode*> MCTS::selectFromNode(MCTSNode* start_node)
 void MCTS::expand(MCTSNode* leaf_node, const std::vector<ActionCandidate>& action_candidates)
 {
     assert(leaf_node && action_candidates.size() > 0);
-    leaf_node->setFirstChild(allocateNodes(action_candidates.size()));
-    leaf_node->setNumChildren(action_candidates.size());
-    for (size_t i = 0; i < action_candidates.size(); ++i) {
+    // with lazy expansion, only the first child is materialized and the priors of the others are kept until they are first selected, which requires the candidates sorted by policy
+    // the root is always fully expanded since noise changes the order of its children
+    const int num_action_candidates = action_candidates.size();
+    const bool lazy_expansion = (config::actor_mcts_lazy_expansion && leaf_node != getRootNode());
+    const int num_children = (lazy_expansion ? 1 : num_action_candidates);
+    if (lazy_expansion) {
+        assert(std::is_sorted(action_candidates.begin(), action_candidates.end(), [](const ActionCandidate& lhs, const ActionCandidate& rhs) { return lhs.policy_ > rhs.policy_; }));
+        leaf_node->setActionCandidateIndex(tree_action_priors_.size());
+        for (int i = num_children; i < num_action_candidates; ++i) {
+            const auto& candidate = action_candidates[i];
+            tree_action_priors_.push_back(ActionPrior{candidate.action_.getActionID(), candidate.policy_, candidate.policy_logit_});
+        }
+    }
+
+    // initialize the children before publishing them, other search threads may be selecting from this node
+    MCTSNode* first_child = allocateNodes(getChildrenCapacity(num_children, num_action_candidates));
+    for (int i = 0; i < num_children; ++i) {
         const auto& candidate = action_candidates[i];
-        MCTSNode* child = leaf_node->getChild(i);
-        child->reset();
+        MCTSNode* child = first_child + i;
+        initializeNode(child);
         child->setAction(candidate.action_);
         child->setPolicy(candidate.policy_);
         child->setPolicyLogit(candidate.policy_logit_);
     }
+    leaf_node->setNumActionCandidates(num_action_candidates);
+    leaf_node->setFirstChild(first_child);
+    leaf_node->setNumChildren(num_children);
 }
 
 void MCTS::backup(const std::vector<MCTSNode*>& node_path, const float value, const float reward /* = 0.0f */)
@@ -178,9 +273,114 @@ void MCTS::backup(const std::vector<MCTSNode*>& node_path, const float value, co
     }
 }
 
+void MCTS::backupAtomic(const std::vector<MCTSNode*>& node_path, const float value, const float reward /* = 0.0f */)
+{
+    // same as backup, but other search threads may update the same nodes; the value bound is not maintained
+    assert(node_path.size() > 0 && !config::actor_mcts_value_rescale);
+    float updated_value = value;
+    node_path.back()->setValue(value);
+    node_path.back()->setReward(reward);
+    for (int i = static_cast<int>(node_path.size() - 1); i >= 0; --i) {
+        MCTSNode* node = node_path[i];
+        node->addAtomic(updated_value);
+        updated_value = node->getReward() + config::actor_mcts_reward_discount * updated_value;
+    }
+}
+
+MCTSNode* MCTS::findNode(const std::vector<Action>& actions)
+{
+    // return the node reached by playing the actions from the root, or nullptr if it is not in the tree
+    MCTSNode* node = getRootNode();
+    for (const auto& action : actions) {
+        MCTSNode* next_node = nullptr;
+        for (int i = 0; i < node->getNumChildren(); ++i) {
+            MCTSNode* child = node->getChild(i);
+            if (child->getAction().getActionID() != action.getActionID() || child->getAction().getPlayer() != action.getPlayer()) { continue; }
+            next_node = child;
+            break;
+        }
+        if (!next_node) { return nullptr; }
+        node = next_node;
+    }
+    return node;
+}
+
+void MCTS::removeChildren(MCTSNode* node, const std::vector<bool>& is_removed)
+{
+    // remove the children together with the statistics they contributed to the node, the remaining children keep their order
+    assert(node && node->isFullyExpanded() && static_cast<int>(is_removed.size()) == node->getNumChildren());
+    int num_children = 0;
+    for (int i = 0; i < node->getNumChildren(); ++i) {
+        MCTSNode* child = node->getChild(i);
+        if (is_removed[i]) {
+            if (child->getCount() > 0) { node->remove(child->getReward() + config::actor_mcts_reward_discount * child->getMean(), child->getCount()); }
+            continue;
+        }
+        if (num_children != i) { copyNode(child, node->getChild(num_children)); }
+        ++num_children;
+    }
+    node->setNumActionCandidates(num_children);
+    node->setNumChildren(num_children);
+}
+
+void MCTS::reuseSubTree(MCTSNode* node)
+{
+    // promote the node to the root and compact its subtree to the front of the node arena
+    assert(node && node != getRootNode() && !node->isLeaf());
+    materializeAllChildren(node);
+    std::vector<std::tuple<MCTSNode*, int, int>> children_blocks; // first child, number of reserved children, number of materialized children
+    std::vector<int> hidden_state_data_indices;
+    std::vector<ActionPrior> action_priors;
+    TreeValueBound tree_value_bound;
+    std::vector<MCTSNode*> stack{node};
+    while (!stack.empty()) {
+        MCTSNode* current = stack.back();
+        stack.pop_back();
+        if (config::actor_mcts_value_rescale && current->getCount() > 0) { tree_value_bound.add(current->getReward() + config::actor_mcts_reward_discount * current->getMean()); }
+        if (current->getHiddenStateDataIndex() != -1) { hidden_state_data_indices.push_back(current->getHiddenStateDataIndex()); }
+        if (current->isLeaf()) { continue; }
+        if (!current->isFullyExpanded()) {
+            auto begin = tree_action_priors_.begin() + current->getActionCandidateIndex();
+            current->setActionCandidateIndex(action_priors.size());
+            action_priors.insert(action_priors.end(), begin, begin + current->getNumActionCandidates() - 1);
+        }
+        children_blocks.emplace_back(current->getChild(0), getChildrenCapacity(current->getNumChildren(), current->getNumActionCandidates()), current->getNumChildren());
+        for (int i = 0; i < current->getNumChildren(); ++i) { stack.push_back(current->getChild(i)); }
+    }
+    tree_action_priors_.swap(action_priors);
+    tree_value_bound_.swap(tree_value_bound);
+
+    // each block keeps its capacity and is moved to an address no larger than its own, so moving the blocks in address order never overwrites a block before it is moved
+    std::sort(children_blocks.begin(), children_blocks.end());
+    std::unordered_map<const MCTSNode*, MCTSNode*> new_first_child;
+    MCTSNode* destination = getRootNode() + 1;
+    for (const auto& block : children_blocks) {
+        new_first_child[std::get<0>(block)] = destination;
+        destination += std::get<1>(block);
+    }
+    std::sort(hidden_state_data_indices.begin(), hidden_state_data_indices.end());
+    std::vector<int> new_hidden_state_data_index(tree_hidden_state_data_.size(), -1);
+    for (size_t i = 0; i < hidden_state_data_indices.size(); ++i) { new_hidden_state_data_index[hidden_state_data_indices[i]] = i; }
+
+    auto move_node = [&](MCTSNode* from, MCTSNode* to) {
+        if (!from->isLeaf()) { from->setFirstChild(new_first_child[from->getChild(0)]); }
+        if (from->getHiddenStateDataIndex() != -1) { from->setHiddenStateDataIndex(new_hidden_state_data_index[from->getHiddenStateDataIndex()]); }
+        copyNode(from, to);
+    };
+    move_node(node, getRootNode());
+    for (const auto& block : children_blocks) {
+        MCTSNode* first_child = new_first_child[std::get<0>(block)];
+        for (int i = 0; i < std::get<2>(block); ++i) { move_node(std::get<0>(block) + i, first_child + i); }
+    }
+    current_node_size_ = destination - getRootNode();
+    tree_hidden_state_data_.compact(hidden_state_data_indices);
+}
+
 MCTSNode* MCTS::selectChildByPUCTScore(const MCTSNode* node) const
 {
     assert(node && !node->isLeaf());
+    if (config::actor_mcts_use_puct_kernel) { return selectChildByPUCTKernel(node); }
+
     MCTSNode* selected = nullptr;
     int total_simulation = node->getCountWithVirtualLoss() - 1;
     float init_q_value = calculateInitQValue(node);
@@ -201,6 +401,8 @@ float MCTS::calculateInitQValue(const MCTSNode* node) const
 {
     // init Q value = avg Q value of all visited children + one loss
     assert(node && !node->isLeaf());
+    if (config::actor_mcts_use_puct_kernel) { return calculateInitQValueByPUCTKernel(node); }
+
     float sum_of_win = 0.0f, sum = 0.0f;
     for (int i = 0; i < node->getNumChildren(); ++i) {
         MCTSNode* child = node->getChild(i);
@@ -208,23 +410,116 @@ float MCTS::calculateInitQValue(const MCTSNode* node) const
         sum_of_win += child->getNormalizedMean(tree_value_bound_);
         sum += 1;
     }
-#if ATARI
-    // explore more in Atari games (TODO: check if this method also performs better in board games)
-    return (sum > 0 ? sum_of_win / sum : 1.0f);
-#else
-    return (sum_of_win - 1) / (sum + 1);
-#endif
+    return MCTSNode::getInitQValue(sum_of_win, sum);
 }
 
 void MCTS::updateTreeValueBound(float old_value, float new_value)
 {
     if (!config::actor_mcts_value_rescale) { return; }
-    if (tree_value_bound_.count(old_value)) {
-        assert(tree_value_bound_[old_value] > 0);
-        --tree_value_bound_[old_value];
-        if (tree_value_bound_[old_value] == 0) { tree_value_bound_.erase(old_value); }
+    tree_value_bound_.update(old_value, new_value);
+}
+
+void MCTS::copyNode(const MCTSNode* source, MCTSNode* destination)
+{
+    // the destination may not be constructed yet
+    if (source == destination) { return; }
+    new (destination) MCTSNode(*source);
+    node_store_.copy(source, destination);
+}
+
+void MCTS::initializeNode(MCTSNode* node)
+{
+    // the node arena is allocated without construction, so a node is constructed when it is first used
+    new (node) MCTSNode(&node_store_);
+}
+
+MCTSNode* MCTS::materializeChild(MCTSNode* node)
+{
+    assert(node && !node->isLeaf() && !node->isFullyExpanded());
+    const int index = node->getNumChildren();
+    if (index == getChildrenCapacity(index, node->getNumActionCandidates())) {
+        // the block is full, move the children to a larger one and leave their new locations in the old block for the paths still holding them, see getMovedNode
+        // the lazy expansion is single-threaded, so no other thread is selecting from this node
+        MCTSNode* first_child = allocateNodes(getChildrenCapacity(index + 1, node->getNumActionCandidates()));
+        for (int i = 0; i < index; ++i) {
+            copyNode(node->getChild(i), first_child + i);
+            node->getChild(i)->setMovedNode(first_child + i);
+        }
+        node->setFirstChild(first_child);
     }
-    ++tree_value_bound_[new_value];
+    const ActionPrior& prior = tree_action_priors_[node->getActionCandidateIndex() + index - 1];
+    MCTSNode* child = node->getChild(0) + index;
+    initializeNode(child);
+    child->setAction(Action(prior.action_id_, node->getChild(0)->getAction().getPlayer()));
+    child->setPolicy(prior.policy_);
+    child->setPolicyLogit(prior.policy_logit_);
+    node->setNumChildren(index + 1);
+    return child;
+}
+
+int MCTS::getChildrenCapacity(int num_children, int num_action_candidates)
+{
+    // the children of a lazily expanded node are kept in a block doubled from 4 nodes when it is full, a fully expanded node has no spare capacity
+    int capacity = 4;
+    while (capacity < num_children) { capacity *= 2; }
+    return std::min(capacity, num_action_candidates);
+}
+
+MCTSNode* MCTS::getMovedNode(MCTSNode* node) const
+{
+    // the current location of a node held before its siblings were moved by materializeChild
+    while (node->isMoved()) { node = node->getMovedNode(); }
+    return node;
+}
+
+void MCTS::materializeAllChildren(MCTSNode* node)
+{
+    assert(node);
+    if (node->isLeaf()) { return; }
+    while (!node->isFullyExpanded()) { materializeChild(node); }
+    node->setActionCandidateIndex(-1);
+}
+
+MCTSNode* MCTS::selectChildByPUCTKernel(const MCTSNode* node) const
+{
+    // same as selectChildByPUCTScore, but scores the contiguous child statistics in one pass
+    return node->getChild(puct_kernel_.selectChild(getPUCTChildren(node), getPUCTParameters(node)));
+}
+
+float MCTS::calculateInitQValueByPUCTKernel(const MCTSNode* node) const
+{
+    return puct_kernel_.calculateInitQValue(getPUCTChildren(node), getPUCTParameters(node));
+}
+
+PUCTChildren MCTS::getPUCTChildren(const MCTSNode* node) const
+{
+    assert(node && !node->isLeaf());
+    const uint64_t first_child_index = node_store_.getIndex(node->getChild(0));
+    PUCTChildren children;
+    children.num_children_ = node->getNumChildren();
+    children.policy_ = node_store_.getPolicy() + first_child_index;
+    children.count_ = node_store_.getCount() + first_child_index;
+    children.mean_ = node_store_.getMean() + first_child_index;
+    children.virtual_loss_ = node_store_.getVirtualLoss() + first_child_index;
+    children.reward_ = node_store_.getReward() + first_child_index;
+    return children;
+}
+
+PUCTParameters MCTS::getPUCTParameters(const MCTSNode* node) const
+{
+    assert(node && !node->isLeaf());
+    bool flip_value = (node->getChild(0)->getAction().getPlayer() == env::charToPlayer(config::actor_mcts_value_flipping_player));
+    return MCTSNode::getPUCTParameters(node->getCountWithVirtualLoss() - 1, flip_value, tree_value_bound_);
+}
+
+TreeNode* MCTS::createTreeNodes(uint64_t tree_node_size)
+{
+    // the memory is not touched until the nodes are constructed, so only the pages of the used nodes are committed
+    MCTSNode* nodes = static_cast<MCTSNode*>(std::calloc(tree_node_size, sizeof(MCTSNode)));
+    assert(nodes);
+    node_store_.allocate(nodes, tree_node_size);
+    initializeNode(nodes);
+    return nodes;
 }
 
 } // namespace minizero::actor
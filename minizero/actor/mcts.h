@@ -2,75 +2,217 @@
 
 #include "configuration.h"
 #include "environment.h"
+#include "puct_kernel.h"
 #include "random.h"
 #include "search.h"
 #include "tree.h"
+#include "tree_hidden_state_data.h"
+#include "tree_value_bound.h"
 #include <algorithm>
 #include <cmath>
+#include <cstdlib>
 #include <limits>
-#include <map>
+#include <new>
 #include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace minizero::actor {
 
+class MCTSNodeStore;
+
+// the statistics read by PUCT selection (policy, count, mean, virtual loss, and reward) are kept in the structure-of-arrays node store of the tree, see MCTSNodeStore
 class MCTSNode : public TreeNode {
 public:
-    MCTSNode() { reset(); }
+    MCTSNode(MCTSNodeStore* node_store) : node_store_(node_store) { reset(); }
 
     void reset() override;
     virtual void add(float value, float weight = 1.0f);
     virtual void remove(float value, float weight = 1.0f);
-    virtual float getNormalizedMean(const std::map<float, int>& tree_value_bound) const;
-    virtual float getNormalizedPUCTScore(int total_simulation, const std::map<float, int>& tree_value_bound, float init_q_value = -1.0f) const;
+    virtual float getNormalizedMean(const TreeValueBound& tree_value_bound) const;
+    virtual float getNormalizedPUCTScore(int total_simulation, const TreeValueBound& tree_value_bound, float init_q_value = -1.0f) const;
     std::string toString() const override;
-    bool displayInTreeLog() const override { return count_ > 0; }
+    bool displayInTreeLog() const override { return getCount() > 0; }
+
+    // the formulas of the PUCT selection, shared by the nodes and the PUCT kernel so that both select the same child
+    static PUCTParameters getPUCTParameters(int total_simulation, bool flip_value, const TreeValueBound& tree_value_bound);
+    static inline float getNormalizedMean(float reward, float mean, float count, float virtual_loss, const PUCTParameters& parameters);
+    static inline float getPUCTBias(const PUCTParameters& parameters);
+    static inline float getPUCTScore(float puct_bias, double sqrt_total_simulation, float policy, float count_with_virtual_loss, float value_q);
+    static inline float getInitQValue(float sum_of_win, float num_visited_children);
+
+    // thread-safe updates for the multi-threaded search
+    void addAtomic(float value, float weight = 1.0f);
+    inline void addVirtualLossAtomic(float num = 1.0f);
+    inline void removeVirtualLossAtomic(float num = 1.0f);
+    inline bool tryLockExpansion() { return !__atomic_test_and_set(&expansion_lock_, __ATOMIC_ACQUIRE); }
+    inline void unlockExpansion() { __atomic_clear(&expansion_lock_, __ATOMIC_RELEASE); }
 
     // setter
     inline void setHiddenStateDataIndex(int hidden_state_data_index) { hidden_state_data_index_ = hidden_state_data_index; }
-    inline void setMean(float mean) { mean_ = mean; }
-    inline void setCount(float count) { count_ = count; }
-    inline void addVirtualLoss(float num = 1.0f) { virtual_loss_ += num; }
-    inline void removeVirtualLoss(float num = 1.0f) { virtual_loss_ -= num; }
-    inline void setPolicy(float policy) { policy_ = policy; }
+    inline void setActionCandidateIndex(int action_candidate_index) { action_candidate_index_ = action_candidate_index; }
+    inline void setNumActionCandidates(int num_action_candidates) { num_action_candidates_ = num_action_candidates; }
+    inline void setMean(float mean);
+    inline void setCount(float count);
+    inline void addVirtualLoss(float num = 1.0f);
+    inline void removeVirtualLoss(float num = 1.0f);
+    inline void setPolicy(float policy);
     inline void setPolicyLogit(float policy_logit) { policy_logit_ = policy_logit; }
     inline void setPolicyNoise(float policy_noise) { policy_noise_ = policy_noise; }
     inline void setValue(float value) { value_ = value; }
-    inline void setReward(float reward) { reward_ = reward; }
+    inline void setReward(float reward);
     inline void setFirstChild(MCTSNode* first_child) { TreeNode::setFirstChild(first_child); }
+    inline void setMovedNode(MCTSNode* node)
+    {
+        num_action_candidates_ = -1;
+        TreeNode::setFirstChild(node);
+    }
 
     // getter
     inline int getHiddenStateDataIndex() const { return hidden_state_data_index_; }
-    inline float getMean() const { return mean_; }
-    inline float getCount() const { return count_; }
-    inline float getCountWithVirtualLoss() const { return count_ + virtual_loss_; }
-    inline float getVirtualLoss() const { return virtual_loss_; }
-    inline float getPolicy() const { return policy_; }
+    inline int getActionCandidateIndex() const { return action_candidate_index_; }
+    inline int getNumActionCandidates() const { return num_action_candidates_; }
+    inline bool isFullyExpanded() const { return getNumChildren() == num_action_candidates_; }
+    inline bool isMoved() const { return num_action_candidates_ == -1; }
+    inline MCTSNode* getMovedNode() const { return static_cast<MCTSNode*>(first_child_); }
+    inline float getMean() const;
+    inline float getCount() const;
+    inline float getCountWithVirtualLoss() const { return getCount() + getVirtualLoss(); }
+    inline float getVirtualLoss() const;
+    inline float getPolicy() const;
     inline float getPolicyLogit() const { return policy_logit_; }
     inline float getPolicyNoise() const { return policy_noise_; }
     inline float getValue() const { return value_; }
-    inline float getReward() const { return reward_; }
+    inline float getReward() const;
     inline virtual MCTSNode* getChild(int index) const override { return (index < num_children_ ? static_cast<MCTSNode*>(first_child_) + index : nullptr); }
 
 protected:
+    static inline void addFloatAtomic(float* target, float value)
+    {
+        float expected, desired;
+        __atomic_load(target, &expected, __ATOMIC_RELAXED);
+        do {
+            desired = expected + value;
+        } while (!__atomic_compare_exchange(target, &expected, &desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    }
+
+    // the statistics updated by the search threads are read and written atomically, which are plain moves on x86
+    static inline float loadFloatAtomic(const float* source)
+    {
+        float value;
+        __atomic_load(source, &value, __ATOMIC_RELAXED);
+        return value;
+    }
+    static inline void storeFloatAtomic(float* target, float value) { __atomic_store(target, &value, __ATOMIC_RELAXED); }
+
+    // the first member is placed in the tail padding of TreeNode
     int hidden_state_data_index_;
-    float mean_;
-    float count_;
-    float virtual_loss_;
-    float policy_;
+    MCTSNodeStore* node_store_;
+    int action_candidate_index_; // the priors of the sorted candidates of a lazily expanded node, see MCTS::expand
+    int num_action_candidates_;  // the number of children, the first num_children_ of them are materialized; -1 if the node is moved to getMovedNode()
     float policy_logit_;
     float policy_noise_;
     float value_;
-    float reward_;
+    bool update_lock_;    // guards the mean and the count in addAtomic
+    bool expansion_lock_; // held by the search thread evaluating this leaf, and kept after the expansion
 };
 
-class HiddenStateData {
+// structure-of-arrays statistics of the nodes in the tree arena, indexed by the position of the node in the arena
+// since the children of a node are allocated contiguously, their statistics are also contiguous in each array
+class MCTSNodeStore {
 public:
-    HiddenStateData(const std::vector<float>& hidden_state)
-        : hidden_state_(hidden_state) {}
-    std::vector<float> hidden_state_;
+    MCTSNodeStore()
+        : size_(0),
+          nodes_(nullptr),
+          policy_(nullptr),
+          count_(nullptr),
+          mean_(nullptr),
+          virtual_loss_(nullptr),
+          reward_(nullptr) {}
+    ~MCTSNodeStore() { release(); }
+
+    void allocate(MCTSNode* nodes, uint64_t size);
+    void release();
+    void copy(const MCTSNode* source, const MCTSNode* destination);
+
+    inline uint64_t getIndex(const MCTSNode* node) const
+    {
+        assert(node >= nodes_ && static_cast<uint64_t>(node - nodes_) < size_);
+        return node - nodes_;
+    }
+    inline float* getPolicy() { return policy_; }
+    inline float* getCount() { return count_; }
+    inline float* getMean() { return mean_; }
+    inline float* getVirtualLoss() { return virtual_loss_; }
+    inline float* getReward() { return reward_; }
+    inline const float* getPolicy() const { return policy_; }
+    inline const float* getCount() const { return count_; }
+    inline const float* getMean() const { return mean_; }
+    inline const float* getVirtualLoss() const { return virtual_loss_; }
+    inline const float* getReward() const { return reward_; }
+
+private:
+    static float* allocateArray(uint64_t size);
+
+    uint64_t size_;
+    MCTSNode* nodes_;
+    float* policy_;
+    float* count_;
+    float* mean_;
+    float* virtual_loss_;
+    float* reward_;
 };
-typedef TreeData<HiddenStateData> TreeHiddenStateData;
+
+inline void MCTSNode::setMean(float mean) { storeFloatAtomic(node_store_->getMean() + node_store_->getIndex(this), mean); }
+inline void MCTSNode::setCount(float count) { storeFloatAtomic(node_store_->getCount() + node_store_->getIndex(this), count); }
+inline void MCTSNode::addVirtualLoss(float num /* = 1.0f */) { node_store_->getVirtualLoss()[node_store_->getIndex(this)] += num; }
+inline void MCTSNode::removeVirtualLoss(float num /* = 1.0f */) { node_store_->getVirtualLoss()[node_store_->getIndex(this)] -= num; }
+inline void MCTSNode::setPolicy(float policy) { node_store_->getPolicy()[node_store_->getIndex(this)] = policy; }
+inline void MCTSNode::setReward(float reward) { node_store_->getReward()[node_store_->getIndex(this)] = reward; }
+inline void MCTSNode::addVirtualLossAtomic(float num /* = 1.0f */) { addFloatAtomic(node_store_->getVirtualLoss() + node_store_->getIndex(this), num); }
+inline void MCTSNode::removeVirtualLossAtomic(float num /* = 1.0f */) { addFloatAtomic(node_store_->getVirtualLoss() + node_store_->getIndex(this), -num); }
+inline float MCTSNode::getMean() const { return loadFloatAtomic(node_store_->getMean() + node_store_->getIndex(this)); }
+inline float MCTSNode::getCount() const { return loadFloatAtomic(node_store_->getCount() + node_store_->getIndex(this)); }
+inline float MCTSNode::getVirtualLoss() const { return loadFloatAtomic(node_store_->getVirtualLoss() + node_store_->getIndex(this)); }
+inline float MCTSNode::getPolicy() const { return node_store_->getPolicy()[node_store_->getIndex(this)]; }
+inline float MCTSNode::getReward() const { return node_store_->getReward()[node_store_->getIndex(this)]; }
+
+inline float MCTSNode::getNormalizedMean(float reward, float mean, float count, float virtual_loss, const PUCTParameters& parameters)
+{
+    float value = reward + parameters.reward_discount_ * mean;
+    if (parameters.value_rescale_) {
+        if (!parameters.has_value_bound_) { return 1.0f; }
+        value = (value - parameters.value_lower_bound_) / (parameters.value_upper_bound_ - parameters.value_lower_bound_);
+        value = fmin(1, fmax(-1, 2 * value - 1)); // normalize to [-1, 1]
+    }
+    value = (parameters.flip_value_ ? -value : value);               // flip value according to player
+    value = (value * count - virtual_loss) / (count + virtual_loss); // value with virtual loss
+    return value;
+}
+
+inline float MCTSNode::getPUCTBias(const PUCTParameters& parameters)
+{
+    return parameters.puct_init_ + log((1 + parameters.total_simulation_ + parameters.puct_base_) / parameters.puct_base_);
+}
+
+inline float MCTSNode::getPUCTScore(float puct_bias, double sqrt_total_simulation, float policy, float count_with_virtual_loss, float value_q)
+{
+    float value_u = (puct_bias * policy * sqrt_total_simulation) / (1 + count_with_virtual_loss);
+    return value_u + value_q;
+}
+
+inline float MCTSNode::getInitQValue(float sum_of_win, float num_visited_children)
+{
+    // init Q value = avg Q value of all visited children + one loss
+#if ATARI
+    // explore more in Atari games (TODO: check if this method also performs better in board games)
+    return (num_visited_children > 0 ? sum_of_win / num_visited_children : 1.0f);
+#else
+    return (sum_of_win - 1) / (num_visited_children + 1);
+#endif
+}
 
 class MCTS : public Tree, public Search {
 public:
@@ -83,9 +225,19 @@ public:
             : action_(action), policy_(policy), policy_logit_(policy_logit) {}
     };
 
+    // the prior of a candidate that is not materialized yet, its player is the same as the first child
+    class ActionPrior {
+    public:
+        int action_id_;
+        float policy_;
+        float policy_logit_;
+    };
+
     MCTS(uint64_t tree_node_size)
         : Tree(tree_node_size) {}
 
+    static uint64_t getTreeNodeSize(int num_simulation, int action_size);
+
     void reset() override;
     virtual bool isResign(const MCTSNode* selected_node) const;
     virtual MCTSNode* selectChildByMaxCount(const MCTSNode* node) const;
@@ -95,27 +247,44 @@ public:
     virtual std::vector<MCTSNode*> selectFromNode(MCTSNode* start_node);
     virtual void expand(MCTSNode* leaf_node, const std::vector<ActionCandidate>& action_candidates);
     virtual void backup(const std::vector<MCTSNode*>& node_path, const float value, const float reward = 0.0f);
+    virtual void backupAtomic(const std::vector<MCTSNode*>& node_path, const float value, const float reward = 0.0f);
+    virtual MCTSNode* findNode(const std::vector<Action>& actions);
+    virtual void removeChildren(MCTSNode* node, const std::vector<bool>& is_removed);
+    virtual void reuseSubTree(MCTSNode* node);
+    virtual void materializeAllChildren(MCTSNode* node);
+    MCTSNode* getMovedNode(MCTSNode* node) const;
 
-    inline MCTSNode* allocateNodes(int size) { return static_cast<MCTSNode*>(Tree::allocateNodes(size)); }
+    inline MCTSNode* allocateNodes(int size) { return getRootNode() + allocateNodeIndex(size); }
     inline int getNumSimulation() const { return getRootNode()->getCount(); }
-    inline bool reachMaximumSimulation() const { return (getNumSimulation() == config::actor_num_simulation + 1); }
+    inline bool reachMaximumSimulation() const { return (getNumSimulation() >= config::actor_num_simulation + 1); }
     inline MCTSNode* getRootNode() { return static_cast<MCTSNode*>(Tree::getRootNode()); }
     inline const MCTSNode* getRootNode() const { return static_cast<const MCTSNode*>(Tree::getRootNode()); }
     inline TreeHiddenStateData& getTreeHiddenStateData() { return tree_hidden_state_data_; }
     inline const TreeHiddenStateData& getTreeHiddenStateData() const { return tree_hidden_state_data_; }
-    inline std::map<float, int>& getTreeValueBound() { return tree_value_bound_; }
-    inline const std::map<float, int>& getTreeValueBound() const { return tree_value_bound_; }
+    inline TreeValueBound& getTreeValueBound() { return tree_value_bound_; }
+    inline const TreeValueBound& getTreeValueBound() const { return tree_value_bound_; }
 
 protected:
-    TreeNode* createTreeNodes(uint64_t tree_node_size) override { return new MCTSNode[tree_node_size]; }
+    TreeNode* createTreeNodes(uint64_t tree_node_size) override;
     TreeNode* getNodeIndex(int index) override { return getRootNode() + index; }
 
     virtual MCTSNode* selectChildByPUCTScore(const MCTSNode* node) const;
     virtual float calculateInitQValue(const MCTSNode* node) const;
     virtual void updateTreeValueBound(float old_value, float new_value);
+    void copyNode(const MCTSNode* source, MCTSNode* destination);
+    void initializeNode(MCTSNode* node);
+    MCTSNode* materializeChild(MCTSNode* node);
+    static int getChildrenCapacity(int num_children, int num_action_candidates);
+    MCTSNode* selectChildByPUCTKernel(const MCTSNode* node) const;
+    float calculateInitQValueByPUCTKernel(const MCTSNode* node) const;
+    PUCTChildren getPUCTChildren(const MCTSNode* node) const;
+    PUCTParameters getPUCTParameters(const MCTSNode* node) const;
 
-    std::map<float, int> tree_value_bound_;
+    PUCTKernel puct_kernel_;
+    MCTSNodeStore node_store_;
+    TreeValueBound tree_value_bound_;
     TreeHiddenStateData tree_hidden_state_data_;
+    std::vector<ActionPrior> tree_action_priors_;
 };
 
 } // namespace minizero::actor
@@ -0,0 +1,240 @@
+#include "puct_kernel.h"
+#include "mcts.h"
+#include <cassert>
+#include <cmath>
+#include <immintrin.h>
+#include <limits>
+#include <vector>
+
+namespace minizero::actor {
+
+// Note: this file is compiled with -ffp-contract=off (see CMakeLists.txt) so that the vectorized
+// kernels round exactly as the scalar formulas shared with MCTSNode, which keeps the selected child identical
+
+namespace {
+
+void calculateNormalizedMeanScalar(const PUCTChildren& children, const PUCTParameters& parameters, int start, float* normalized_mean)
+{
+    for (int i = start; i < children.num_children_; ++i) {
+        normalized_mean[i] = MCTSNode::getNormalizedMean(children.reward_[i], children.mean_[i], children.count_[i], children.virtual_loss_[i], parameters);
+    }
+}
+
+void calculateScoreScalar(const PUCTChildren& children, const PUCTParameters& parameters, const float* normalized_mean, float init_q_value, int start, float* score)
+{
+    float puct_bias = MCTSNode::getPUCTBias(parameters);
+    double sqrt_total_simulation = sqrt(parameters.total_simulation_);
+    for (int i = start; i < children.num_children_; ++i) {
+        float count_with_virtual_loss = children.count_[i] + children.virtual_loss_[i];
+        float value_q = (count_with_virtual_loss == 0 ? init_q_value : normalized_mean[i]);
+        score[i] = MCTSNode::getPUCTScore(puct_bias, sqrt_total_simulation, children.policy_[i], count_with_virtual_loss, value_q);
+    }
+}
+
+__attribute__((target("avx2"))) void calculateNormalizedMeanAVX2(const PUCTChildren& children, const PUCTParameters& parameters, float* normalized_mean)
+{
+    const int kWidth = 8;
+    const __m256 reward_discount = _mm256_set1_ps(parameters.reward_discount_);
+    const __m256 value_lower_bound = _mm256_set1_ps(parameters.value_lower_bound_);
+    const __m256 value_range = _mm256_set1_ps(parameters.value_upper_bound_ - parameters.value_lower_bound_);
+    const __m256 one = _mm256_set1_ps(1.0f), minus_one = _mm256_set1_ps(-1.0f), two = _mm256_set1_ps(2.0f);
+    const __m256 sign_mask = _mm256_set1_ps(parameters.flip_value_ ? -0.0f : 0.0f);
+    const bool use_constant_value = (parameters.value_rescale_ && !parameters.has_value_bound_);
+    int i = 0;
+    for (; i + kWidth <= children.num_children_; i += kWidth) {
+        if (use_constant_value) {
+            _mm256_storeu_ps(normalized_mean + i, one);
+            continue;
+        }
+        const __m256 count = _mm256_loadu_ps(children.count_ + i);
+        const __m256 virtual_loss = _mm256_loadu_ps(children.virtual_loss_ + i);
+        __m256 value = _mm256_add_ps(_mm256_loadu_ps(children.reward_ + i), _mm256_mul_ps(reward_discount, _mm256_loadu_ps(children.mean_ + i)));
+        if (parameters.value_rescale_) {
+            value = _mm256_div_ps(_mm256_sub_ps(value, value_lower_bound), value_range);
+            value = _mm256_min_ps(one, _mm256_max_ps(minus_one, _mm256_sub_ps(_mm256_mul_ps(two, value), one)));
+        }
+        value = _mm256_xor_ps(value, sign_mask);
+        value = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(value, count), virtual_loss), _mm256_add_ps(count, virtual_loss));
+        _mm256_storeu_ps(normalized_mean + i, value);
+    }
+    calculateNormalizedMeanScalar(children, parameters, i, normalized_mean);
+}
+
+__attribute__((target("avx2"))) void calculateScoreAVX2(const PUCTChildren& children, const PUCTParameters& parameters, const float* normalized_mean, float init_q_value, float* score)
+{
+    // value_u is evaluated in double precision as in MCTSNode::getNormalizedPUCTScore
+    const int kWidth = 8;
+    const __m256 puct_bias = _mm256_set1_ps(MCTSNode::getPUCTBias(parameters));
+    const __m256d sqrt_total_simulation = _mm256_set1_pd(sqrt(parameters.total_simulation_));
+    const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+    const __m256 init_q = _mm256_set1_ps(init_q_value);
+    int i = 0;
+    for (; i + kWidth <= children.num_children_; i += kWidth) {
+        const __m256 count_with_virtual_loss = _mm256_add_ps(_mm256_loadu_ps(children.count_ + i), _mm256_loadu_ps(children.virtual_loss_ + i));
+        const __m256 numerator = _mm256_mul_ps(puct_bias, _mm256_loadu_ps(children.policy_ + i));
+        const __m256 denominator = _mm256_add_ps(one, count_with_virtual_loss);
+        const __m128 value_u_low = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(numerator)), sqrt_total_simulation), _mm256_cvtps_pd(_mm256_castps256_ps128(denominator))));
+        const __m128 value_u_high = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(numerator, 1)), sqrt_total_simulation), _mm256_cvtps_pd(_mm256_extractf128_ps(denominator, 1))));
+        const __m256 value_u = _mm256_insertf128_ps(_mm256_castps128_ps256(value_u_low), value_u_high, 1);
+        const __m256 value_q = _mm256_blendv_ps(_mm256_loadu_ps(normalized_mean + i), init_q, _mm256_cmp_ps(count_with_virtual_loss, zero, _CMP_EQ_OQ));
+        _mm256_storeu_ps(score + i, _mm256_add_ps(value_u, value_q));
+    }
+    calculateScoreScalar(children, parameters, normalized_mean, init_q_value, i, score);
+}
+
+__attribute__((target("avx512f"))) void calculateNormalizedMeanAVX512(const PUCTChildren& children, const PUCTParameters& parameters, float* normalized_mean)
+{
+    const int kWidth = 16;
+    const __m512 reward_discount = _mm512_set1_ps(parameters.reward_discount_);
+    const __m512 value_lower_bound = _mm512_set1_ps(parameters.value_lower_bound_);
+    const __m512 value_range = _mm512_set1_ps(parameters.value_upper_bound_ - parameters.value_lower_bound_);
+    const __m512 one = _mm512_set1_ps(1.0f), minus_one = _mm512_set1_ps(-1.0f), two = _mm512_set1_ps(2.0f);
+    const __m512i sign_mask = _mm512_set1_epi32(parameters.flip_value_ ? 0x80000000 : 0);
+    const bool use_constant_value = (parameters.value_rescale_ && !parameters.has_value_bound_);
+    int i = 0;
+    for (; i + kWidth <= children.num_children_; i += kWidth) {
+        if (use_constant_value) {
+            _mm512_storeu_ps(normalized_mean + i, one);
+            continue;
+        }
+        const __m512 count = _mm512_loadu_ps(children.count_ + i);
+        const __m512 virtual_loss = _mm512_loadu_ps(children.virtual_loss_ + i);
+        __m512 value = _mm512_add_ps(_mm512_loadu_ps(children.reward_ + i), _mm512_mul_ps(reward_discount, _mm512_loadu_ps(children.mean_ + i)));
+        if (parameters.value_rescale_) {
+            value = _mm512_div_ps(_mm512_sub_ps(value, value_lower_bound), value_range);
+            value = _mm512_min_ps(one, _mm512_max_ps(minus_one, _mm512_sub_ps(_mm512_mul_ps(two, value), one)));
+        }
+        value = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(value), sign_mask));
+        value = _mm512_div_ps(_mm512_sub_ps(_mm512_mul_ps(value, count), virtual_loss), _mm512_add_ps(count, virtual_loss));
+        _mm512_storeu_ps(normalized_mean + i, value);
+    }
+    calculateNormalizedMeanScalar(children, parameters, i, normalized_mean);
+}
+
+__attribute__((target("avx512f"))) void calculateScoreAVX512(const PUCTChildren& children, const PUCTParameters& parameters, const float* normalized_mean, float init_q_value, float* score)
+{
+    const int kWidth = 16;
+    const __m512 puct_bias = _mm512_set1_ps(MCTSNode::getPUCTBias(parameters));
+    const __m512d sqrt_total_simulation = _mm512_set1_pd(sqrt(parameters.total_simulation_));
+    const __m512 one = _mm512_set1_ps(1.0f), zero = _mm512_setzero_ps();
+    const __m512 init_q = _mm512_set1_ps(init_q_value);
+    int i = 0;
+    for (; i + kWidth <= children.num_children_; i += kWidth) {
+        const __m512 count_with_virtual_loss = _mm512_add_ps(_mm512_loadu_ps(children.count_ + i), _mm512_loadu_ps(children.virtual_loss_ + i));
+        const __m512 numerator = _mm512_mul_ps(puct_bias, _mm512_loadu_ps(children.policy_ + i));
+        const __m512 denominator = _mm512_add_ps(one, count_with_virtual_loss);
+        const __m256 numerator_low = _mm512_castps512_ps256(numerator);
+        const __m256 numerator_high = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(numerator), 1));
+        const __m256 denominator_low = _mm512_castps512_ps256(denominator);
+        const __m256 denominator_high = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(denominator), 1));
+        const __m256 value_u_low = _mm512_cvtpd_ps(_mm512_div_pd(_mm512_mul_pd(_mm512_cvtps_pd(numerator_low), sqrt_total_simulation), _mm512_cvtps_pd(denominator_low)));
+        const __m256 value_u_high = _mm512_cvtpd_ps(_mm512_div_pd(_mm512_mul_pd(_mm512_cvtps_pd(numerator_high), sqrt_total_simulation), _mm512_cvtps_pd(denominator_high)));
+        const __m512 value_u = _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_castps_pd(value_u_low)), _mm256_castps_pd(value_u_high), 1));
+        const __m512 value_q = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(count_with_virtual_loss, zero, _CMP_EQ_OQ), _mm512_loadu_ps(normalized_mean + i), init_q);
+        _mm512_storeu_ps(score + i, _mm512_add_ps(value_u, value_q));
+    }
+    calculateScoreScalar(children, parameters, normalized_mean, init_q_value, i, score);
+}
+
+} // namespace
+
+std::string getPUCTKernelTypeString(PUCTKernelType type)
+{
+    switch (type) {
+        case PUCTKernelType::kScalar: return "scalar";
+        case PUCTKernelType::kAVX2: return "avx2";
+        case PUCTKernelType::kAVX512: return "avx512";
+        default: return "unknown";
+    }
+}
+
+bool isPUCTKernelTypeSupported(PUCTKernelType type)
+{
+    switch (type) {
+        case PUCTKernelType::kScalar: return true;
+        case PUCTKernelType::kAVX2: return __builtin_cpu_supports("avx2");
+        case PUCTKernelType::kAVX512: return __builtin_cpu_supports("avx512f");
+        default: return false;
+    }
+}
+
+PUCTKernelType getBestPUCTKernelType()
+{
+    static const PUCTKernelType best_type = []() {
+        if (isPUCTKernelTypeSupported(PUCTKernelType::kAVX512)) { return PUCTKernelType::kAVX512; }
+        if (isPUCTKernelTypeSupported(PUCTKernelType::kAVX2)) { return PUCTKernelType::kAVX2; }
+        return PUCTKernelType::kScalar;
+    }();
+    return best_type;
+}
+
+PUCTKernel::PUCTKernel(PUCTKernelType type /* = getBestPUCTKernelType() */)
+    : type_(isPUCTKernelTypeSupported(type) ? type : PUCTKernelType::kScalar)
+{
+}
+
+int PUCTKernel::selectChild(const PUCTChildren& children, const PUCTParameters& parameters) const
+{
+    assert(children.num_children_ > 0);
+    thread_local std::vector<float> normalized_mean, score;
+    if (static_cast<int>(score.size()) < children.num_children_) {
+        normalized_mean.resize(children.num_children_);
+        score.resize(children.num_children_);
+    }
+
+    calculateNormalizedMean(children, parameters, normalized_mean.data());
+    float init_q_value = calculateInitQValue(children, normalized_mean.data());
+    calculateScore(children, parameters, normalized_mean.data(), init_q_value, score.data());
+
+    // keep the same tie-break as MCTS::selectChildByPUCTScore: prefer higher policy, then the first child
+    int selected = -1;
+    float best_score = std::numeric_limits<float>::lowest(), best_policy = std::numeric_limits<float>::lowest();
+    for (int i = 0; i < children.num_children_; ++i) {
+        if (score[i] < best_score || (score[i] == best_score && children.policy_[i] <= best_policy)) { continue; }
+        best_score = score[i];
+        best_policy = children.policy_[i];
+        selected = i;
+    }
+    assert(selected != -1);
+    return selected;
+}
+
+float PUCTKernel::calculateInitQValue(const PUCTChildren& children, const PUCTParameters& parameters) const
+{
+    thread_local std::vector<float> normalized_mean;
+    if (static_cast<int>(normalized_mean.size()) < children.num_children_) { normalized_mean.resize(children.num_children_); }
+    calculateNormalizedMean(children, parameters, normalized_mean.data());
+    return calculateInitQValue(children, normalized_mean.data());
+}
+
+void PUCTKernel::calculateNormalizedMean(const PUCTChildren& children, const PUCTParameters& parameters, float* normalized_mean) const
+{
+    switch (type_) {
+        case PUCTKernelType::kAVX512: return calculateNormalizedMeanAVX512(children, parameters, normalized_mean);
+        case PUCTKernelType::kAVX2: return calculateNormalizedMeanAVX2(children, parameters, normalized_mean);
+        default: return calculateNormalizedMeanScalar(children, parameters, 0, normalized_mean);
+    }
+}
+
+void PUCTKernel::calculateScore(const PUCTChildren& children, const PUCTParameters& parameters, const float* normalized_mean, float init_q_value, float* score) const
+{
+    switch (type_) {
+        case PUCTKernelType::kAVX512: return calculateScoreAVX512(children, parameters, normalized_mean, init_q_value, score);
+        case PUCTKernelType::kAVX2: return calculateScoreAVX2(children, parameters, normalized_mean, init_q_value, score);
+        default: return calculateScoreScalar(children, parameters, normalized_mean, init_q_value, 0, score);
+    }
+}
+
+float PUCTKernel::calculateInitQValue(const PUCTChildren& children, const float* normalized_mean) const
+{
+    // summed sequentially to keep the same rounding as MCTS::calculateInitQValue
+    float sum_of_win = 0.0f, sum = 0.0f;
+    for (int i = 0; i < children.num_children_; ++i) {
+        if (children.count_[i] + children.virtual_loss_[i] == 0) { continue; }
+        sum_of_win += normalized_mean[i];
+        sum += 1;
+    }
+    return MCTSNode::getInitQValue(sum_of_win, sum);
+}
+
+} // namespace minizero::actor
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+
+namespace minizero::actor {
+
+enum class PUCTKernelType {
+    kScalar,
+    kAVX2,
+    kAVX512,
+    kPUCTKernelTypeSize
+};
+
+std::string getPUCTKernelTypeString(PUCTKernelType type);
+bool isPUCTKernelTypeSupported(PUCTKernelType type);
+PUCTKernelType getBestPUCTKernelType();
+
+// contiguous statistics of all children of a node, see MCTSNodeStore
+class PUCTChildren {
+public:
+    int num_children_;
+    const float* policy_;
+    const float* count_;
+    const float* mean_;
+    const float* virtual_loss_;
+    const float* reward_;
+};
+
+// parent-dependent terms of MCTSNode::getNormalizedMean and MCTSNode::getNormalizedPUCTScore
+class PUCTParameters {
+public:
+    int total_simulation_;
+    float puct_init_;
+    float puct_base_;
+    float reward_discount_;
+    bool flip_value_;
+    bool value_rescale_;
+    bool has_value_bound_; // false if value rescale is enabled but the tree has less than two distinct values
+    float value_lower_bound_;
+    float value_upper_bound_;
+};
+
+// scores all children of a node in one pass, results are identical to MCTS::selectChildByPUCTScore and MCTS::calculateInitQValue
+class PUCTKernel {
+public:
+    PUCTKernel(PUCTKernelType type = getBestPUCTKernelType());
+
+    int selectChild(const PUCTChildren& children, const PUCTParameters& parameters) const;
+    float calculateInitQValue(const PUCTChildren& children, const PUCTParameters& parameters) const;
+
+    inline PUCTKernelType getType() const { return type_; }
+
+private:
+    void calculateNormalizedMean(const PUCTChildren& children, const PUCTParameters& parameters, float* normalized_mean) const;
+    void calculateScore(const PUCTChildren& children, const PUCTParameters& parameters, const float* normalized_mean, float init_q_value, float* score) const;
+    float calculateInitQValue(const PUCTChildren& children, const float* normalized_mean) const;
+
+    PUCTKernelType type_;
+};
+
+} // namespace minizero::actor
@@ -6,29 +6,6 @@
 
 namespace minizero::actor {
 
-template <class Data>
-class TreeData {
-public:
-    TreeData() { reset(); }
-
-    inline void reset() { data_.clear(); }
-    inline int store(const Data& data)
-    {
-        int index = data_.size();
-        data_.push_back(data);
-        return index;
-    }
-    inline const Data& getData(int index) const
-    {
-        assert(index >= 0 && index < size());
-        return data_[index];
-    }
-    inline int size() const { return data_.size(); }
-
-private:
-    std::vector<Data> data_;
-};
-
 class TreeNode {
 public:
     TreeNode() {}
@@ -38,18 +15,19 @@ public:
     virtual std::string toString() const = 0;
     virtual bool displayInTreeLog() const { return true; }
 
-    inline bool isLeaf() const { return (num_children_ == 0); }
+    // the number of children is published with release/acquire ordering so that the children are initialized before other search threads see them
+    inline bool isLeaf() const { return (getNumChildren() == 0); }
     inline void setAction(Action action) { action_ = action; }
-    inline void setNumChildren(int num_children) { num_children_ = num_children; }
+    inline void setNumChildren(int num_children) { __atomic_store_n(&num_children_, num_children, __ATOMIC_RELEASE); }
     inline void setFirstChild(TreeNode* first_child) { first_child_ = first_child; }
     inline Action getAction() const { return action_; }
-    inline int getNumChildren() const { return num_children_; }
+    inline int getNumChildren() const { return __atomic_load_n(&num_children_, __ATOMIC_ACQUIRE); }
     inline virtual TreeNode* getChild(int index) const { return (index < num_children_ ? first_child_ + index : nullptr); }
 
 protected:
     Action action_;
-    int num_children_;
     TreeNode* first_child_;
+    int num_children_;
 };
 
 class Tree {
@@ -68,12 +46,13 @@ public:
         getRootNode()->reset();
     }
 
-    inline TreeNode* allocateNodes(int size)
+    inline TreeNode* allocateNodes(int size) { return getNodeIndex(allocateNodeIndex(size)); }
+    inline uint64_t allocateNodeIndex(int size)
     {
-        assert(current_node_size_ + size <= 1 + tree_node_size_);
-        TreeNode* node = getNodeIndex(current_node_size_);
-        current_node_size_ += size;
-        return node;
+        // thread-safe, different leaves can be expanded concurrently
+        uint64_t index = __atomic_fetch_add(&current_node_size_, size, __ATOMIC_RELAXED);
+        assert(index + size <= 1 + tree_node_size_);
+        return index;
     }
 
     std::string toString(const std::string& env_string)
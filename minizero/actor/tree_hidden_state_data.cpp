@@ -0,0 +1,158 @@
+#include "tree_hidden_state_data.h"
+#include "configuration.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+namespace minizero::actor {
+
+namespace {
+
+inline uint32_t getBits(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline float getFloat(uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint16_t floatToHalf(float value)
+{
+    // round to the nearest even, the values out of the fp16 range become infinity or (subnormal) zero
+    const uint32_t bits = getBits(value);
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t float_exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (float_exponent == 0xFF) { return sign | 0x7C00 | (mantissa ? 0x200 : 0); } // infinity or NaN
+    const int exponent = static_cast<int>(float_exponent) - 127 + 15;
+    if (exponent >= 31) { return sign | 0x7C00; }
+    if (exponent <= 0) {
+        if (exponent < -10) { return sign; }
+        mantissa |= 0x800000;
+        const int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) { ++half; }
+        return sign | half;
+    }
+    uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) { ++half; } // a carry into the exponent is still correctly rounded
+    return half;
+}
+
+float halfToFloat(uint16_t half)
+{
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    if (exponent == 0x1F) { return getFloat(sign | 0x7F800000 | (mantissa << 13)); }
+    if (exponent != 0) { return getFloat(sign | ((exponent + 127 - 15) << 23) | (mantissa << 13)); }
+    if (mantissa == 0) { return getFloat(sign); }
+
+    // subnormal, normalize the mantissa
+    exponent = 127 - 15 + 1;
+    while (!(mantissa & 0x400)) {
+        mantissa <<= 1;
+        --exponent;
+    }
+    return getFloat(sign | (exponent << 23) | ((mantissa & 0x3FF) << 13));
+}
+
+inline uint16_t floatToBFloat16(float value)
+{
+    // round to the nearest even, and keep NaN a NaN
+    uint32_t bits = getBits(value);
+    if ((bits & 0x7FFFFFFF) > 0x7F800000) { return (bits >> 16) | 0x40; }
+    bits += 0x7FFF + ((bits >> 16) & 1);
+    return bits >> 16;
+}
+
+inline float bfloat16ToFloat(uint16_t value) { return getFloat(static_cast<uint32_t>(value) << 16); }
+
+} // namespace
+
+TreeHiddenStateData::TreeHiddenStateData()
+    : precision_(getPrecisionFromString(config::actor_mcts_hidden_state_precision)),
+      hidden_state_size_(0),
+      entry_size_(0),
+      size_(0),
+      capacity_(0)
+{
+}
+
+int TreeHiddenStateData::store(const float* hidden_state, int hidden_state_size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (hidden_state_size_ == 0) {
+        hidden_state_size_ = hidden_state_size;
+        entry_size_ = (precision_ == Precision::kFP32 ? 2 * hidden_state_size_ : hidden_state_size_);
+    }
+    assert(hidden_state_size == hidden_state_size_);
+
+    // the arena only grows if a search stores more states than its simulations, e.g., with a reused subtree
+    if (size_ == capacity_) { grow(std::max(config::actor_num_simulation + 1, 2 * capacity_)); }
+    const int index = size_++;
+    uint16_t* entry = data_.data() + static_cast<int64_t>(index) * entry_size_;
+    switch (precision_) {
+        case Precision::kFP32: std::memcpy(entry, hidden_state, hidden_state_size_ * sizeof(float)); break;
+        case Precision::kFP16:
+            for (int i = 0; i < hidden_state_size_; ++i) { entry[i] = floatToHalf(hidden_state[i]); }
+            break;
+        case Precision::kBF16:
+            for (int i = 0; i < hidden_state_size_; ++i) { entry[i] = floatToBFloat16(hidden_state[i]); }
+            break;
+    }
+    return index;
+}
+
+void TreeHiddenStateData::load(int index, float* hidden_state) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(index >= 0 && index < size_);
+    const uint16_t* entry = data_.data() + static_cast<int64_t>(index) * entry_size_;
+    switch (precision_) {
+        case Precision::kFP32: std::memcpy(hidden_state, entry, hidden_state_size_ * sizeof(float)); break;
+        case Precision::kFP16:
+            for (int i = 0; i < hidden_state_size_; ++i) { hidden_state[i] = halfToFloat(entry[i]); }
+            break;
+        case Precision::kBF16:
+            for (int i = 0; i < hidden_state_size_; ++i) { hidden_state[i] = bfloat16ToFloat(entry[i]); }
+            break;
+    }
+}
+
+void TreeHiddenStateData::compact(const std::vector<int>& indices)
+{
+    // keep only the states of the ascending indices, the i-th kept state is moved to index i
+    for (size_t i = 0; i < indices.size(); ++i) {
+        assert(indices[i] >= static_cast<int>(i) && indices[i] < size_);
+        if (indices[i] == static_cast<int>(i)) { continue; }
+        std::memcpy(data_.data() + static_cast<int64_t>(i) * entry_size_, data_.data() + static_cast<int64_t>(indices[i]) * entry_size_, entry_size_ * sizeof(uint16_t));
+    }
+    size_ = indices.size();
+}
+
+TreeHiddenStateData::Precision TreeHiddenStateData::getPrecisionFromString(const std::string& precision)
+{
+    if (precision == "fp16") { return Precision::kFP16; }
+    if (precision == "bf16") { return Precision::kBF16; }
+    if (precision != "fp32") { std::cerr << "Unknown hidden state precision " << precision << ", the hidden states are stored in fp32." << std::endl; }
+    return Precision::kFP32;
+}
+
+void TreeHiddenStateData::grow(int capacity)
+{
+    capacity_ = capacity;
+    data_.resize(static_cast<int64_t>(capacity_) * entry_size_);
+}
+
+} // namespace minizero::actor
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace minizero::actor {
+
+// the MuZero hidden states of a tree in one preallocated arena, optionally stored in fp16 or bf16 to halve the memory
+// the arena is allocated for actor_num_simulation + 1 states at the first store and kept across searches, so storing a state does not allocate
+// store and load are thread-safe for the multi-threaded search
+class TreeHiddenStateData {
+public:
+    enum class Precision {
+        kFP32,
+        kFP16,
+        kBF16
+    };
+
+    TreeHiddenStateData();
+
+    inline void reset() { size_ = 0; }
+    int store(const float* hidden_state, int hidden_state_size); // e.g., straight from the row of a network output
+    void load(int index, float* hidden_state) const; // write the hidden state as fp32, e.g., to the recurrent input of a network batch
+    inline int size() const { return size_; }
+    void compact(const std::vector<int>& indices);
+
+    static Precision getPrecisionFromString(const std::string& precision);
+
+private:
+    void grow(int capacity);
+
+    Precision precision_;
+    int hidden_state_size_;
+    int entry_size_; // the number of uint16_t per hidden state
+    int size_;
+    int capacity_;
+    std::vector<uint16_t> data_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace minizero::actor
@@ -0,0 +1,125 @@
+#include "tree_value_bound.h"
+#include <algorithm>
+#include <functional>
+
+namespace minizero::actor {
+
+void TreeValueBound::clear()
+{
+    num_values_ = 0;
+    capacity_bits_ = 10;
+    keys_.assign(1 << capacity_bits_, 0);
+    counts_.assign(1 << capacity_bits_, 0);
+    lower_heap_.clear();
+    upper_heap_.clear();
+}
+
+void TreeValueBound::add(float value)
+{
+    uint32_t key = getKey(value);
+    int slot = findSlot(key);
+    if (counts_[slot]++ > 0) { return; }
+
+    // a new distinct value
+    keys_[slot] = key;
+    value = getValue(key);
+    lower_heap_.push_back(value);
+    std::push_heap(lower_heap_.begin(), lower_heap_.end(), std::greater<float>());
+    upper_heap_.push_back(value);
+    std::push_heap(upper_heap_.begin(), upper_heap_.end(), std::less<float>());
+    if (2 * ++num_values_ > static_cast<int>(counts_.size())) { resize(2 * counts_.size()); }
+}
+
+void TreeValueBound::remove(float value)
+{
+    // removing a value that is not in the tree is ignored
+    int slot = findSlot(getKey(value));
+    if (counts_[slot] == 0 || --counts_[slot] > 0) { return; }
+    eraseSlot(slot);
+    --num_values_;
+    popRemovedBounds();
+}
+
+void TreeValueBound::update(float old_value, float new_value)
+{
+    remove(old_value);
+    add(new_value);
+
+    // removed values are only popped when they reach the top, rebuild the heaps before they grow much larger than the tree
+    if (static_cast<int>(lower_heap_.size()) > 2 * num_values_ + 64) { rebuildHeaps(); }
+}
+
+void TreeValueBound::swap(TreeValueBound& other)
+{
+    std::swap(num_values_, other.num_values_);
+    std::swap(capacity_bits_, other.capacity_bits_);
+    keys_.swap(other.keys_);
+    counts_.swap(other.counts_);
+    lower_heap_.swap(other.lower_heap_);
+    upper_heap_.swap(other.upper_heap_);
+}
+
+int TreeValueBound::findSlot(uint32_t key) const
+{
+    // linear probing, returns the slot of the key or the empty slot where it would be inserted
+    const int mask = counts_.size() - 1;
+    int slot = getHomeSlot(key);
+    while (counts_[slot] > 0 && keys_[slot] != key) { slot = (slot + 1) & mask; }
+    return slot;
+}
+
+void TreeValueBound::eraseSlot(int slot)
+{
+    // backward shift deletion, moves the following keys of the probe sequence into the hole so that no tombstone is needed
+    const int mask = counts_.size() - 1;
+    for (int next = (slot + 1) & mask; counts_[next] > 0; next = (next + 1) & mask) {
+        int home = getHomeSlot(keys_[next]);
+        if (((next - home) & mask) < ((next - slot) & mask)) { continue; }
+        keys_[slot] = keys_[next];
+        counts_[slot] = counts_[next];
+        slot = next;
+    }
+    counts_[slot] = 0;
+}
+
+void TreeValueBound::resize(int capacity)
+{
+    std::vector<uint32_t> keys;
+    std::vector<int> counts;
+    keys.swap(keys_);
+    counts.swap(counts_);
+    while ((1 << capacity_bits_) < capacity) { ++capacity_bits_; }
+    keys_.assign(1 << capacity_bits_, 0);
+    counts_.assign(1 << capacity_bits_, 0);
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] == 0) { continue; }
+        int slot = findSlot(keys[i]);
+        keys_[slot] = keys[i];
+        counts_[slot] = counts[i];
+    }
+}
+
+void TreeValueBound::popRemovedBounds()
+{
+    while (!lower_heap_.empty() && !contains(lower_heap_.front())) {
+        std::pop_heap(lower_heap_.begin(), lower_heap_.end(), std::greater<float>());
+        lower_heap_.pop_back();
+    }
+    while (!upper_heap_.empty() && !contains(upper_heap_.front())) {
+        std::pop_heap(upper_heap_.begin(), upper_heap_.end(), std::less<float>());
+        upper_heap_.pop_back();
+    }
+}
+
+void TreeValueBound::rebuildHeaps()
+{
+    lower_heap_.clear();
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        if (counts_[i] > 0) { lower_heap_.push_back(getValue(keys_[i])); }
+    }
+    upper_heap_ = lower_heap_;
+    std::make_heap(lower_heap_.begin(), lower_heap_.end(), std::greater<float>());
+    std::make_heap(upper_heap_.begin(), upper_heap_.end(), std::less<float>());
+}
+
+} // namespace minizero::actor
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace minizero::actor {
+
+// the multiset of the values (reward + discount * mean) of the tree nodes, used by value rescaling
+// values are counted in an open addressing hash table and the bounds are kept on the top of two heaps, reading the bounds is constant time
+// updating a value is amortized O(log n) for n distinct values: a new distinct value is pushed to the heaps, and a removed value is only
+// popped when it reaches the top of a heap, so an update of a value that is already counted and is not a bound does not touch the heaps
+class TreeValueBound {
+public:
+    TreeValueBound() { clear(); }
+
+    void clear();
+    void add(float value);
+    void remove(float value);
+    void update(float old_value, float new_value);
+    void swap(TreeValueBound& other);
+
+    inline int getNumValues() const { return num_values_; } // the number of distinct values
+    inline bool hasBound() const { return num_values_ >= 2; }
+    inline float getLowerBound() const { return (lower_heap_.empty() ? 0.0f : lower_heap_.front()); }
+    inline float getUpperBound() const { return (upper_heap_.empty() ? 0.0f : upper_heap_.front()); }
+
+private:
+    int findSlot(uint32_t key) const;
+    void eraseSlot(int slot);
+    void resize(int capacity);
+    void popRemovedBounds();
+    void rebuildHeaps();
+
+    inline bool contains(float value) const { return counts_[findSlot(getKey(value))] > 0; }
+    inline int getHomeSlot(uint32_t key) const { return (key * 2654435769u) >> (32 - capacity_bits_); }
+    inline uint32_t getKey(float value) const
+    {
+        // 0.0f and -0.0f are the same value
+        value += 0.0f;
+        uint32_t key;
+        std::memcpy(&key, &value, sizeof(key));
+        return key;
+    }
+    inline float getValue(uint32_t key) const
+    {
+        float value;
+        std::memcpy(&value, &key, sizeof(value));
+        return value;
+    }
+
+    int num_values_;
+    int capacity_bits_;
+    std::vector<uint32_t> keys_;
+    std::vector<int> counts_;       // 0 for empty slots
+    std::vector<float> lower_heap_; // min-heap, may contain values that have been removed
+    std::vector<float> upper_heap_; // max-heap, may contain values that have been removed
+};
+
+} // namespace minizero::actor
@@ -1,8 +1,12 @@
 #include "zero_actor.h"
+#include "profiler.h"
 #include "random.h"
 #include "time_system.h"
+#include "utils.h"
 #include <algorithm>
 #include <memory>
+#include <string>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
@@ -28,21 +32,37 @@ void ZeroActor::reset()
 
 void ZeroActor::resetSearch()
 {
-    BaseActor::resetSearch();
-    mcts_search_data_.node_path_.clear();
+    // the model loaded in the background is taken at the start of a search, so that all leaves of a search are evaluated by the same model
+    if (alphazero_network_ || muzero_network_) { nn_evaluation_model_ = (alphazero_network_ ? alphazero_network_->getModel() : muzero_network_->getModel()); }
+    if (!reuseSearchTree()) { BaseActor::resetSearch(); }
+    search_model_key_ = (nn_evaluation_model_ ? nn_evaluation_model_->key_ : 0);
+    mcts_search_data_.clear();
+    num_transposition_lookups_ = num_transposition_hits_ = 0;
+    transposition_table_.clear();
+    env_transition_.is_valid_ = false;
     getMCTS()->getRootNode()->setAction(Action(-1, env::getPreviousPlayer(env_.getTurn(), env_.getNumPlayer())));
+    search_action_history_ = env_.getActionHistory();
 }
 
 Action ZeroActor::think(bool with_play /*= false*/, bool display_board /*= false*/)
 {
     resetSearch();
     boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
-    while (!isSearchDone()) {
-        step();
-        int spent_million_second = (utils::TimeSystem::getLocalTime() - start_ptime).total_milliseconds();
-        if (config::actor_mcts_think_time_limit > 0 && spent_million_second >= config::actor_mcts_think_time_limit * 1000) { break; }
+    if (isMultiThreadSearch()) {
+        // expand the root before the search threads share the tree
+        if (!isSearchDone() && getMCTS()->getRootNode()->isLeaf()) { step(); }
+        num_started_simulation_ = getMCTS()->getNumSimulation();
+        num_finished_batches_ = 0;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < config::actor_mcts_think_num_threads; ++i) { threads.emplace_back(&ZeroActor::runSearchThread, this, start_ptime); }
+        for (auto& thread : threads) { thread.join(); }
+    } else {
+        while (!isSearchDone()) {
+            step();
+            if (isThinkTimeUp(start_ptime)) { break; }
+        }
     }
-    if (!isSearchDone()) { handleSearchDone(); }
+    if (!mcts_search_data_.selected_node_) { handleSearchDone(); }
     if (with_play) { act(getSearchAction()); }
     if (display_board) { std::cerr << env_.toString() << mcts_search_data_.search_info_ << std::endl; }
     return getSearchAction();
@@ -50,21 +70,37 @@ Action ZeroActor::think(bool with_play /*= false*/, bool display_board /*= false
 
 void ZeroActor::beforeNNEvaluation()
 {
+    utils::ProfileTimer timer(utils::ProfilePhase::kSelection);
     mcts_search_data_.node_path_ = selection();
     if (alphazero_network_) {
-        Environment env_transition = getEnvironmentTransition(mcts_search_data_.node_path_);
-        feature_rotation_ = config::actor_use_random_rotation_features ? static_cast<utils::Rotation>(utils::Random::randInt() % static_cast<int>(utils::Rotation::kRotateSize)) : utils::Rotation::kRotationNone;
-        nn_evaluation_batch_id_ = alphazero_network_->pushBack(env_transition.getFeatures(feature_rotation_));
+        timer.next(utils::ProfilePhase::kTransition);
+        const Environment& env_transition = walkEnvironmentTransition(mcts_search_data_.node_path_);
+        feature_rotation_ = getFeatureRotation();
+        while (evaluateByTranspositionTable(env_transition) || evaluateByNNCache(env_transition)) {
+            timer.next(utils::ProfilePhase::kSelection);
+            mcts_search_data_.node_path_ = selection();
+            timer.next(utils::ProfilePhase::kTransition);
+            walkEnvironmentTransition(mcts_search_data_.node_path_);
+            feature_rotation_ = getFeatureRotation();
+        }
+        timer.next(utils::ProfilePhase::kFeature);
+        std::pair<int, float*> input = (nn_evaluation_input_ ? std::make_pair(0, nn_evaluation_input_) : alphazero_network_->allocateInput(nn_evaluation_model_.get()));
+        env_transition.writeFeatures(input.second, feature_rotation_);
+        nn_evaluation_batch_id_ = input.first;
     } else if (muzero_network_) {
+        timer.next(utils::ProfilePhase::kFeature);
         if (getMCTS()->getNumSimulation() == 0) { // initial inference for root node
-            nn_evaluation_batch_id_ = muzero_network_->pushBackInitialData(env_.getFeatures());
+            std::pair<int, float*> input = muzero_network_->allocateInitialInput(nn_evaluation_model_.get());
+            env_.writeFeatures(input.second);
+            nn_evaluation_batch_id_ = input.first;
         } else { // for non-root nodes
             const std::vector<MCTSNode*>& node_path = mcts_search_data_.node_path_;
             MCTSNode* leaf_node = node_path.back();
             MCTSNode* parent_node = node_path[node_path.size() - 2];
             assert(parent_node && parent_node->getHiddenStateDataIndex() != -1);
-            const std::vector<float>& hidden_state = getMCTS()->getTreeHiddenStateData().getData(parent_node->getHiddenStateDataIndex()).hidden_state_;
-            nn_evaluation_batch_id_ = muzero_network_->pushBackRecurrentData(hidden_state, env_.getActionFeatures(leaf_node->getAction()));
+            std::pair<int, float*> input = muzero_network_->allocateRecurrentInput(env_.getActionFeatures(leaf_node->getAction()), nn_evaluation_model_.get());
+            getMCTS()->getTreeHiddenStateData().load(parent_node->getHiddenStateDataIndex(), input.second);
+            nn_evaluation_batch_id_ = input.first;
         }
     } else {
         assert(false);
@@ -75,12 +111,22 @@ void ZeroActor::afterNNEvaluation(const std::shared_ptr<NetworkOutput>& network_
 {
     const std::vector<MCTSNode*>& node_path = mcts_search_data_.node_path_;
     MCTSNode* leaf_node = node_path.back();
+    utils::ProfileTimer timer(alphazero_network_ ? utils::ProfilePhase::kTransition : utils::ProfilePhase::kBackup);
     if (alphazero_network_) {
-        Environment env_transition = getEnvironmentTransition(node_path);
+        const Environment& env_transition = walkEnvironmentTransition(node_path);
+        timer.next(utils::ProfilePhase::kBackup);
         if (!env_transition.isTerminal()) {
             std::shared_ptr<AlphaZeroNetworkOutput> alphazero_output = std::static_pointer_cast<AlphaZeroNetworkOutput>(network_output);
             getMCTS()->expand(leaf_node, calculateAlphaZeroActionPolicy(env_transition, alphazero_output, feature_rotation_));
             getMCTS()->backup(node_path, alphazero_output->value_, env_transition.getReward());
+            bool is_transposition_stored = (config::actor_mcts_transposition_table && env_transition.getTranspositionHashKey() != 0);
+            bool is_cached = (nn_cache_ && env_transition.getTranspositionHashKey() != 0);
+            if (is_transposition_stored || is_cached) {
+                // the tables keep a copy owning its rows, so that they do not keep the outputs of the whole batch
+                std::shared_ptr<AlphaZeroNetworkOutput> stored_output = alphazero_output->clone();
+                if (is_transposition_stored) { transposition_table_.insert({env_transition.getTranspositionHashKey(), TranspositionEntry{stored_output, feature_rotation_, leaf_node}}); }
+                if (is_cached) { nn_cache_->insert(env_transition.getTranspositionHashKey(), static_cast<int>(feature_rotation_), nn_evaluation_model_->key_, stored_output); }
+            }
         } else {
             getMCTS()->backup(node_path, env_transition.getEvalScore(), env_transition.getReward());
         }
@@ -88,7 +134,7 @@ void ZeroActor::afterNNEvaluation(const std::shared_ptr<NetworkOutput>& network_
         std::shared_ptr<MuZeroNetworkOutput> muzero_output = std::static_pointer_cast<MuZeroNetworkOutput>(network_output);
         getMCTS()->expand(leaf_node, calculateMuZeroActionPolicy(leaf_node, muzero_output));
         getMCTS()->backup(node_path, muzero_output->value_, muzero_output->reward_);
-        leaf_node->setHiddenStateDataIndex(getMCTS()->getTreeHiddenStateData().store(HiddenStateData(muzero_output->hidden_state_)));
+        leaf_node->setHiddenStateDataIndex(getMCTS()->getTreeHiddenStateData().store(muzero_output->hidden_state_.data(), muzero_output->hidden_state_.size()));
     } else {
         assert(false);
     }
@@ -110,13 +156,37 @@ void ZeroActor::setNetwork(const std::shared_ptr<network::Network>& network)
         assert(false);
     }
     assert((alphazero_network_ && !muzero_network_) || (!alphazero_network_ && muzero_network_));
+    search_action_history_.clear(); // do not reuse the tree searched by the previous network
+    if (alphazero_network_ && !config::actor_symmetry_rotations.empty()) { setNetworkSymmetries(); }
+}
+
+void ZeroActor::setNetworkSymmetries()
+{
+    // the position and action tables of the rotations are taken from the environment, so the averaged outputs are in the same order as an unrotated evaluation
+    const int board_area = alphazero_network_->getInputChannelHeight() * alphazero_network_->getInputChannelWidth();
+    std::vector<std::vector<int>> position_tables, action_tables;
+    for (const std::string& rotation_string : utils::stringToVector(config::actor_symmetry_rotations)) {
+        int rotation_id = std::stoi(rotation_string);
+        assert(rotation_id >= 0 && rotation_id < static_cast<int>(utils::Rotation::kRotateSize));
+        utils::Rotation rotation = static_cast<utils::Rotation>(rotation_id);
+        position_tables.emplace_back(board_area);
+        action_tables.emplace_back(alphazero_network_->getActionSize());
+        for (int pos = 0; pos < board_area; ++pos) { position_tables.back()[pos] = env_.getRotatePosition(pos, rotation); }
+        for (int action_id = 0; action_id < alphazero_network_->getActionSize(); ++action_id) { action_tables.back()[action_id] = env_.getRotateAction(action_id, rotation); }
+    }
+    alphazero_network_->setSymmetries(position_tables, action_tables);
 }
 
 std::vector<std::pair<std::string, std::string>> ZeroActor::getActionInfo() const
 {
     // ignore recording mcts action info if there is no search
-    if (getMCTS()->getRootNode()->getCount() > 0) { return BaseActor::getActionInfo(); }
-    return {};
+    if (getMCTS()->getRootNode()->getCount() == 0) { return {}; }
+
+    // the models can be swapped during self-play, so each move records the model that searched it
+    std::vector<std::pair<std::string, std::string>> action_info = BaseActor::getActionInfo();
+    const std::string& nn_file_name = nn_evaluation_model_->file_name_;
+    action_info.push_back({"M", nn_file_name.substr(nn_file_name.find_last_of('/') + 1)});
+    return action_info;
 }
 
 std::string ZeroActor::getEnvReward() const
@@ -129,31 +199,161 @@ std::string ZeroActor::getEnvReward() const
 void ZeroActor::step()
 {
     assert(alphazero_network_ || muzero_network_);
+    bool is_initial_inference = (muzero_network_ && getMCTS()->getNumSimulation() == 0);
+    beforeNNEvaluationBatch(config::actor_mcts_think_batch_size);
+    afterNNEvaluationBatch(alphazero_network_ ? alphazero_network_->forward()
+                                              : (is_initial_inference ? muzero_network_->initialInference() : muzero_network_->recurrentInference()));
+}
+
+void ZeroActor::beforeNNEvaluationBatch(int max_num_leaves)
+{
     int num_simulation = getMCTS()->getNumSimulation();
     int num_simulation_left = config::actor_num_simulation + 1 - num_simulation;
-    int batch_size = std::min(config::actor_mcts_think_batch_size,
-                              (alphazero_network_ || num_simulation > 0) ? num_simulation_left : 1 /* initial inference for root node */);
+    int batch_size = std::min(max_num_leaves, (alphazero_network_ || num_simulation > 0) ? num_simulation_left : 1 /* initial inference for root node */);
     assert(batch_size > 0);
 
-    std::vector<std::tuple<int, utils::Rotation, decltype(mcts_search_data_.node_path_)>> batch_queries; // batch id, rotation, search path
+    batch_queries_.clear();
     for (int batch_id = 0; batch_id < batch_size; batch_id++) {
+        // the simulations evaluated by the transposition table are already done, and each batched one adds a virtual loss to the root
+        if (batch_id > 0 && getMCTS()->getNumSimulation() + getMCTS()->getRootNode()->getVirtualLoss() >= config::actor_num_simulation + 1) { break; }
         beforeNNEvaluation();
-        assert(nn_evaluation_batch_id_ == batch_id);
         if (mcts_search_data_.node_path_.back()->getVirtualLoss() == 0) {
-            batch_queries.emplace_back(nn_evaluation_batch_id_, feature_rotation_, mcts_search_data_.node_path_);
+            batch_queries_.emplace_back(nn_evaluation_batch_id_, feature_rotation_, mcts_search_data_.node_path_);
         }
         for (auto node : mcts_search_data_.node_path_) { node->addVirtualLoss(); }
     }
-    auto network_output = alphazero_network_ ? alphazero_network_->forward()
-                                             : (num_simulation == 0 ? muzero_network_->initialInference() : muzero_network_->recurrentInference());
-    for (auto& query : batch_queries) {
+}
+
+void ZeroActor::afterNNEvaluationBatch(const std::vector<std::shared_ptr<network::NetworkOutput>>& network_outputs)
+{
+    for (auto& query : batch_queries_) {
         nn_evaluation_batch_id_ = std::get<0>(query);
         feature_rotation_ = std::get<1>(query);
         mcts_search_data_.node_path_ = std::get<2>(query);
-        afterNNEvaluation(network_output[nn_evaluation_batch_id_]);
+        for (auto& node : mcts_search_data_.node_path_) { node = getMCTS()->getMovedNode(node); } // the nodes may be moved by the lazy expansion of the later queries
+        assert(nn_evaluation_batch_id_ < static_cast<int>(network_outputs.size()));
+        afterNNEvaluation(network_outputs[nn_evaluation_batch_id_]);
         auto virtual_loss = mcts_search_data_.node_path_.back()->getVirtualLoss();
         for (auto node : mcts_search_data_.node_path_) { node->removeVirtualLoss(virtual_loss); }
     }
+    batch_queries_.clear();
+}
+
+void ZeroActor::runSearchThread(const boost::posix_time::ptime& start_ptime)
+{
+    // each thread selects a batch of leaves with virtual loss, only the network forward is serialized between threads
+    // the leaves are reached by walking the transition environment of this thread, and their features are written to a buffer of this thread, which is copied to the network input under the lock
+    std::shared_ptr<MCTS> mcts = getMCTS();
+    EnvironmentTransition transition;
+    transition.is_valid_ = false;
+    const int feature_size = (alphazero_network_ ? alphazero_network_->getNumInputChannels() * alphazero_network_->getInputChannelHeight() * alphazero_network_->getInputChannelWidth() : 0);
+    std::vector<float> features(config::actor_mcts_think_batch_size * feature_size);
+    std::vector<std::tuple<int, utils::Rotation, std::vector<MCTSNode*>>> batch_queries; // batch id, rotation, search path
+    while (num_started_simulation_ < config::actor_num_simulation + 1 && !isThinkTimeUp(start_ptime)) {
+        const int num_finished_batches = num_finished_batches_;
+        bool is_leaf_locked = false;
+        batch_queries.clear();
+        for (int i = 0; i < config::actor_mcts_think_batch_size; ++i) {
+            if (num_started_simulation_.fetch_add(1) >= config::actor_num_simulation + 1) { break; }
+            std::vector<MCTSNode*> node_path = mcts->select();
+            MCTSNode* leaf_node = node_path.back();
+            for (auto node : node_path) { node->addVirtualLossAtomic(); }
+            if (!leaf_node->tryLockExpansion()) { // the leaf is being evaluated or has been expanded by another thread
+                for (auto node : node_path) { node->removeVirtualLossAtomic(); }
+                --num_started_simulation_;
+                is_leaf_locked = true;
+                continue;
+            }
+
+            utils::Rotation rotation = utils::Rotation::kRotationNone;
+            if (alphazero_network_) {
+                const Environment& env_transition = walkEnvironmentTransition(node_path, transition);
+                if (env_transition.isTerminal()) {
+                    mcts->backupAtomic(node_path, env_transition.getEvalScore(), env_transition.getReward());
+                    leaf_node->unlockExpansion();
+                    for (auto node : node_path) { node->removeVirtualLossAtomic(); }
+                    continue;
+                }
+                rotation = getFeatureRotation();
+                env_transition.writeFeatures(features.data() + batch_queries.size() * feature_size, rotation);
+            }
+            batch_queries.emplace_back(-1, rotation, node_path);
+        }
+        if (batch_queries.empty()) {
+            // the selected leaves are being evaluated by other threads, sleep until one of their batches is backed up instead of selecting them again
+            if (is_leaf_locked) {
+                std::unique_lock<std::mutex> lock(search_mutex_);
+                search_cv_.wait(lock, [this, num_finished_batches] { return num_finished_batches_ != num_finished_batches; });
+            }
+            continue;
+        }
+
+        std::vector<std::shared_ptr<NetworkOutput>> network_output;
+        {
+            std::lock_guard<std::mutex> lock(network_mutex_);
+            for (size_t i = 0; i < batch_queries.size(); ++i) {
+                const std::vector<MCTSNode*>& node_path = std::get<2>(batch_queries[i]);
+                std::pair<int, float*> input;
+                if (alphazero_network_) {
+                    input = alphazero_network_->allocateInput(nn_evaluation_model_.get());
+                    std::copy(features.begin() + i * feature_size, features.begin() + (i + 1) * feature_size, input.second);
+                } else {
+                    MCTSNode* parent_node = node_path[node_path.size() - 2];
+                    assert(parent_node && parent_node->getHiddenStateDataIndex() != -1);
+                    input = muzero_network_->allocateRecurrentInput(env_.getActionFeatures(node_path.back()->getAction()), nn_evaluation_model_.get());
+                    mcts->getTreeHiddenStateData().load(parent_node->getHiddenStateDataIndex(), input.second);
+                }
+                std::get<0>(batch_queries[i]) = input.first;
+            }
+            network_output = (alphazero_network_ ? alphazero_network_->forward() : muzero_network_->recurrentInference());
+        }
+
+        for (auto& query : batch_queries) {
+            const std::vector<MCTSNode*>& node_path = std::get<2>(query);
+            MCTSNode* leaf_node = node_path.back();
+            if (alphazero_network_) {
+                const Environment& env_transition = walkEnvironmentTransition(node_path, transition);
+                std::shared_ptr<AlphaZeroNetworkOutput> alphazero_output = std::static_pointer_cast<AlphaZeroNetworkOutput>(network_output[std::get<0>(query)]);
+                mcts->expand(leaf_node, calculateAlphaZeroActionPolicy(env_transition, alphazero_output, std::get<1>(query)));
+                mcts->backupAtomic(node_path, alphazero_output->value_, env_transition.getReward());
+            } else {
+                // the hidden state must be stored before the children are published
+                std::shared_ptr<MuZeroNetworkOutput> muzero_output = std::static_pointer_cast<MuZeroNetworkOutput>(network_output[std::get<0>(query)]);
+                leaf_node->setHiddenStateDataIndex(mcts->getTreeHiddenStateData().store(muzero_output->hidden_state_.data(), muzero_output->hidden_state_.size()));
+                mcts->expand(leaf_node, calculateMuZeroActionPolicy(leaf_node, muzero_output));
+                mcts->backupAtomic(node_path, muzero_output->value_, muzero_output->reward_);
+            }
+            // keep the expansion lock so that threads which selected this node before it was expanded do not expand it again
+            for (auto node : node_path) { node->removeVirtualLossAtomic(); }
+        }
+        {
+            std::lock_guard<std::mutex> lock(search_mutex_);
+            ++num_finished_batches_;
+        }
+        search_cv_.notify_all();
+    }
+}
+
+bool ZeroActor::isMultiThreadSearch() const
+{
+    if (config::actor_mcts_think_num_threads <= 1) { return false; }
+
+    // the tree value bound, the PUCT kernel, the lazy expansion candidates, the transposition table, and the Gumbel candidates are not thread-safe
+    bool is_multi_thread_search = (!config::actor_mcts_value_rescale && !config::actor_mcts_use_puct_kernel && !config::actor_mcts_lazy_expansion && !config::actor_mcts_transposition_table && !config::actor_use_gumbel);
+    if (!is_multi_thread_search) {
+        static std::once_flag warning_flag;
+        std::call_once(warning_flag, []() {
+            std::cerr << "actor_mcts_think_num_threads=" << config::actor_mcts_think_num_threads << " is ignored and the search runs in one thread, since it does not support "
+                      << "actor_mcts_value_rescale, actor_mcts_use_puct_kernel, actor_mcts_lazy_expansion, actor_mcts_transposition_table, or actor_use_gumbel" << std::endl;
+        });
+    }
+    return is_multi_thread_search;
+}
+
+bool ZeroActor::isThinkTimeUp(const boost::posix_time::ptime& start_ptime) const
+{
+    int spent_million_second = (utils::TimeSystem::getLocalTime() - start_ptime).total_milliseconds();
+    return (config::actor_mcts_think_time_limit > 0 && spent_million_second >= config::actor_mcts_think_time_limit * 1000);
 }
 
 void ZeroActor::handleSearchDone()
@@ -161,14 +361,18 @@ void ZeroActor::handleSearchDone()
     mcts_search_data_.selected_node_ = decideActionNode();
     const Action action = getSearchAction();
     std::ostringstream oss;
-    oss << "model file name: " << config::nn_file_name << std::endl
+    oss << "model file name: " << nn_evaluation_model_->file_name_ << std::endl
         << utils::TimeSystem::getTimeString("[Y/m/d H:i:s.f] ")
         << "move number: " << env_.getActionHistory().size()
         << ", action: " << action.toConsoleString()
         << " (" << action.getActionID() << ")"
         << ", reward: " << env_.getReward()
         << ", player: " << env::playerToChar(action.getPlayer());
-    if (config::actor_mcts_value_rescale) { oss << ", value bound: (" << getMCTS()->getTreeValueBound().begin()->first << ", " << getMCTS()->getTreeValueBound().rbegin()->first << ")"; }
+    if (config::actor_mcts_transposition_table) {
+        oss << ", transposition hit rate: " << (num_transposition_lookups_ > 0 ? 100.0f * num_transposition_hits_ / num_transposition_lookups_ : 0.0f) << "%"
+            << " (" << num_transposition_hits_ << "/" << num_transposition_lookups_ << ")";
+    }
+    if (config::actor_mcts_value_rescale) { oss << ", value bound: (" << getMCTS()->getTreeValueBound().getLowerBound() << ", " << getMCTS()->getTreeValueBound().getUpperBound() << ")"; }
     oss << std::endl
         << "  root node info: " << getMCTS()->getRootNode()->toString() << std::endl
         << "action node info: " << mcts_search_data_.selected_node_->toString() << std::endl;
@@ -212,6 +416,89 @@ void ZeroActor::addNoiseToNodeChildren(MCTSNode* node)
     }
 }
 
+bool ZeroActor::reuseSearchTree()
+{
+    // the tree can be reused if the current position is reached by playing actions from the root of the previous search
+    // the tree searched by another model is not reused, since its hidden states and evaluations are from that model
+    if (!config::actor_mcts_reuse_tree || !search_ || env_.isTerminal() || !nn_evaluation_model_ || nn_evaluation_model_->key_ != search_model_key_) { return false; }
+    const std::vector<Action>& action_history = env_.getActionHistory();
+    if (action_history.size() <= search_action_history_.size()) { return false; }
+    for (size_t i = 0; i < search_action_history_.size(); ++i) {
+        if (action_history[i].getActionID() != search_action_history_[i].getActionID() || action_history[i].getPlayer() != search_action_history_[i].getPlayer()) { return false; }
+    }
+    MCTSNode* node = getMCTS()->findNode(std::vector<Action>(action_history.begin() + search_action_history_.size(), action_history.end()));
+    if (!node || node->isLeaf() || node->getChild(0)->getAction().getPlayer() != env_.getTurn()) { return false; }
+    if (muzero_network_) {
+        // only the children of the root are restricted to legal actions in MuZero
+        getMCTS()->materializeAllChildren(node);
+        std::vector<bool> is_illegal(node->getNumChildren());
+        for (int i = 0; i < node->getNumChildren(); ++i) { is_illegal[i] = !env_.isLegalAction(node->getChild(i)->getAction()); }
+        getMCTS()->removeChildren(node, is_illegal);
+        if (node->isLeaf()) { return false; }
+    }
+
+    nn_evaluation_batch_id_ = -1;
+    getMCTS()->reuseSubTree(node);
+    addNoiseToNodeChildren(getMCTS()->getRootNode());
+    if (config::actor_use_gumbel) { gumbel_zero_.initializeCandidates(getMCTS()); }
+    return true;
+}
+
+utils::Rotation ZeroActor::getFeatureRotation() const
+{
+    // the features are not rotated if the network evaluates all the symmetries
+    return (config::actor_use_random_rotation_features && config::actor_symmetry_rotations.empty()) ? static_cast<utils::Rotation>(utils::Random::randInt() % static_cast<int>(utils::Rotation::kRotateSize)) : utils::Rotation::kRotationNone;
+}
+
+bool ZeroActor::isLeafEvaluableWithoutNetwork(const Environment& env_transition) const
+{
+    // the leaf must not be waiting for a batched evaluation, and the last simulation is always left to the network so that the search is done in afterNNEvaluation
+    if (env_transition.isTerminal() || env_transition.getTranspositionHashKey() == 0) { return false; }
+    MCTSNode* leaf_node = mcts_search_data_.node_path_.back();
+    return (leaf_node->getVirtualLoss() == 0 && getMCTS()->getNumSimulation() + getMCTS()->getRootNode()->getVirtualLoss() + 1 < config::actor_num_simulation + 1);
+}
+
+bool ZeroActor::evaluateByTranspositionTable(const Environment& env_transition)
+{
+    // expand and back up the leaf by the evaluation of the same position reached by another path, returns false if the leaf needs a network evaluation
+    if (!config::actor_mcts_transposition_table || !isLeafEvaluableWithoutNetwork(env_transition)) { return false; }
+    const std::vector<MCTSNode*>& node_path = mcts_search_data_.node_path_;
+    MCTSNode* leaf_node = node_path.back();
+
+    ++num_transposition_lookups_;
+    auto it = transposition_table_.find(env_transition.getTranspositionHashKey());
+    if (it == transposition_table_.end()) { return false; }
+    ++num_transposition_hits_;
+    const TranspositionEntry& entry = it->second;
+    const MCTSNode* entry_node = getMCTS()->getMovedNode(entry.node_);
+    float value = entry.alphazero_output_->value_;
+    if (config::actor_mcts_transposition_merge_statistics && entry_node->getCount() > 0) { value = entry_node->getMean(); }
+    getMCTS()->expand(leaf_node, calculateAlphaZeroActionPolicy(env_transition, entry.alphazero_output_, entry.rotation_));
+    getMCTS()->backup(node_path, value, env_transition.getReward());
+    if (config::actor_use_gumbel) { gumbel_zero_.sequentialHalving(getMCTS()); }
+    return true;
+}
+
+bool ZeroActor::evaluateByNNCache(const Environment& env_transition)
+{
+    // expand and back up the leaf by the evaluation of the same position with the same rotation by any actor, returns false if the leaf needs a network evaluation
+    // the root is left to the network so that its noise is added in afterNNEvaluation
+    if (!nn_cache_ || !isLeafEvaluableWithoutNetwork(env_transition)) { return false; }
+    const std::vector<MCTSNode*>& node_path = mcts_search_data_.node_path_;
+    MCTSNode* leaf_node = node_path.back();
+    if (leaf_node == getMCTS()->getRootNode()) { return false; }
+
+    std::shared_ptr<AlphaZeroNetworkOutput> alphazero_output = nn_cache_->lookup(env_transition.getTranspositionHashKey(), static_cast<int>(feature_rotation_), nn_evaluation_model_->key_);
+    if (!alphazero_output) { return false; }
+    getMCTS()->expand(leaf_node, calculateAlphaZeroActionPolicy(env_transition, alphazero_output, feature_rotation_));
+    getMCTS()->backup(node_path, alphazero_output->value_, env_transition.getReward());
+    if (config::actor_mcts_transposition_table) {
+        transposition_table_.insert({env_transition.getTranspositionHashKey(), TranspositionEntry{alphazero_output, feature_rotation_, leaf_node}});
+    }
+    if (config::actor_use_gumbel) { gumbel_zero_.sequentialHalving(getMCTS()); }
+    return true;
+}
+
 std::vector<MCTS::ActionCandidate> ZeroActor::calculateAlphaZeroActionPolicy(const Environment& env_transition, const std::shared_ptr<network::AlphaZeroNetworkOutput>& alphazero_output, const utils::Rotation& rotation)
 {
     assert(alphazero_network_);
@@ -251,4 +538,27 @@ Environment ZeroActor::getEnvironmentTransition(const std::vector<MCTSNode*>& no
     return env;
 }
 
+const Environment& ZeroActor::walkEnvironmentTransition(const std::vector<MCTSNode*>& node_path, EnvironmentTransition& transition)
+{
+    // move the transition environment from the last walked leaf to this leaf by undoing and playing the actions where the paths differ
+    // for the games with undo (tic-tac-toe, Gomoku, Othello, and chess), the cost is proportional to the different part of the paths instead of the game length
+    // the other games copy env_ whenever the paths diverge, which is almost every simulation, e.g., Go, since undoing a capture would need a journal of its blocks, areas, and liberties
+    // MuZero environments such as Atari are never walked, the search expands the hidden states instead
+    size_t num_shared_nodes = 0;
+    if (transition.is_valid_) {
+        while (num_shared_nodes < transition.node_path_.size() && num_shared_nodes + 1 < node_path.size() && transition.node_path_[num_shared_nodes] == node_path[num_shared_nodes + 1]) { ++num_shared_nodes; }
+        while (transition.node_path_.size() > num_shared_nodes && transition.env_.undo()) { transition.node_path_.pop_back(); }
+    }
+    if (!transition.is_valid_ || transition.node_path_.size() > num_shared_nodes) {
+        transition.env_ = env_;
+        transition.node_path_.clear();
+        transition.is_valid_ = true;
+    }
+    for (size_t i = transition.node_path_.size() + 1; i < node_path.size(); ++i) {
+        transition.env_.act(node_path[i]->getAction());
+        transition.node_path_.push_back(node_path[i]);
+    }
+    return transition.env_;
+}
+
 } // namespace minizero::actor
@@ -5,8 +5,13 @@
 #include "gumbel_zero.h"
 #include "mcts.h"
 #include "muzero_network.h"
+#include "time_system.h"
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -21,11 +26,26 @@ public:
     void clear();
 };
 
+class TranspositionEntry {
+public:
+    std::shared_ptr<network::AlphaZeroNetworkOutput> alphazero_output_;
+    utils::Rotation rotation_;
+    MCTSNode* node_; // the node that first evaluated the position in the current search
+};
+
+class EnvironmentTransition {
+public:
+    bool is_valid_;
+    Environment env_;                  // the root environment after playing the actions of node_path_
+    std::vector<MCTSNode*> node_path_; // the nodes below the root of the last walked path
+};
+
 class ZeroActor : public BaseActor {
 public:
     ZeroActor(uint64_t tree_node_size)
         : tree_node_size_(tree_node_size)
     {
+        search_model_key_ = 0;
         alphazero_network_ = nullptr;
         muzero_network_ = nullptr;
     }
@@ -35,6 +55,8 @@ public:
     Action think(bool with_play = false, bool display_board = false) override;
     void beforeNNEvaluation() override;
     void afterNNEvaluation(const std::shared_ptr<network::NetworkOutput>& network_output) override;
+    void beforeNNEvaluationBatch(int max_num_leaves) override;
+    void afterNNEvaluationBatch(const std::vector<std::shared_ptr<network::NetworkOutput>>& network_outputs) override;
     bool isSearchDone() const override { return getMCTS()->reachMaximumSimulation(); }
     Action getSearchAction() const override { return mcts_search_data_.selected_node_->getAction(); }
     bool isResign() const override { return enable_resign_ && getMCTS()->isResign(mcts_search_data_.selected_node_); }
@@ -43,6 +65,7 @@ public:
     std::shared_ptr<Search> createSearch() override { return std::make_shared<MCTS>(tree_node_size_); }
     std::shared_ptr<MCTS> getMCTS() { return std::static_pointer_cast<MCTS>(search_); }
     const std::shared_ptr<MCTS> getMCTS() const { return std::static_pointer_cast<MCTS>(search_); }
+    bool isMultiThreadSearch() const;
 
 protected:
     std::vector<std::pair<std::string, std::string>> getActionInfo() const override;
@@ -51,20 +74,42 @@ protected:
     std::string getEnvReward() const override;
 
     virtual void step();
+    virtual void runSearchThread(const boost::posix_time::ptime& start_ptime);
+    void setNetworkSymmetries();
+    bool isThinkTimeUp(const boost::posix_time::ptime& start_ptime) const;
     virtual void handleSearchDone();
     virtual MCTSNode* decideActionNode();
     virtual void addNoiseToNodeChildren(MCTSNode* node);
+    virtual bool reuseSearchTree();
+    bool isLeafEvaluableWithoutNetwork(const Environment& env_transition) const;
+    virtual bool evaluateByTranspositionTable(const Environment& env_transition);
+    virtual bool evaluateByNNCache(const Environment& env_transition);
+    utils::Rotation getFeatureRotation() const;
     virtual std::vector<MCTSNode*> selection() { return (config::actor_use_gumbel ? gumbel_zero_.selection(getMCTS()) : getMCTS()->select()); }
 
     std::vector<MCTS::ActionCandidate> calculateAlphaZeroActionPolicy(const Environment& env_transition, const std::shared_ptr<network::AlphaZeroNetworkOutput>& alphazero_output, const utils::Rotation& rotation);
     std::vector<MCTS::ActionCandidate> calculateMuZeroActionPolicy(MCTSNode* leaf_node, const std::shared_ptr<network::MuZeroNetworkOutput>& muzero_output);
     virtual Environment getEnvironmentTransition(const std::vector<MCTSNode*>& node_path);
+    const Environment& walkEnvironmentTransition(const std::vector<MCTSNode*>& node_path) { return walkEnvironmentTransition(node_path, env_transition_); }
+    virtual const Environment& walkEnvironmentTransition(const std::vector<MCTSNode*>& node_path, EnvironmentTransition& transition);
 
     bool enable_resign_;
     GumbelZero gumbel_zero_;
     uint64_t tree_node_size_;
     MCTSSearchData mcts_search_data_;
+    std::vector<std::tuple<int, utils::Rotation, std::vector<MCTSNode*>>> batch_queries_; // batch id, rotation, search path
+    std::vector<Action> search_action_history_;
+    int num_transposition_lookups_;
+    int num_transposition_hits_;
+    std::unordered_map<uint64_t, TranspositionEntry> transposition_table_;
+    EnvironmentTransition env_transition_; // the transition environment of the single-threaded search, each search thread walks its own
+    std::mutex network_mutex_;
+    std::atomic<int> num_started_simulation_;
+    std::atomic<int> num_finished_batches_; // the batches backed up by the search threads, the threads waiting for the leaves of other threads wake when it changes
+    std::mutex search_mutex_;
+    std::condition_variable search_cv_;
     utils::Rotation feature_rotation_;
+    uint64_t search_model_key_; // the key of the model the tree was searched by
     std::shared_ptr<network::AlphaZeroNetwork> alphazero_network_;
     std::shared_ptr<network::MuZeroNetwork> muzero_network_;
 };
@@ -7,6 +7,7 @@ namespace minizero::config {
 int program_seed = 0;
 bool program_auto_seed = false;
 bool program_quiet = false;
+std::string program_thread_affinity = "";
 
 // actor parameters
 int actor_num_simulation = 50;
@@ -14,14 +15,23 @@ float actor_mcts_puct_base = 19652;
 float actor_mcts_puct_init = 1.25;
 float actor_mcts_reward_discount = 1.0f;
 int actor_mcts_think_batch_size = 1;
+int actor_mcts_self_play_batch_size = 1;
 float actor_mcts_think_time_limit = 0;
+int actor_mcts_think_num_threads = 1;
 bool actor_mcts_value_rescale = false;
+bool actor_mcts_use_puct_kernel = false;
+bool actor_mcts_reuse_tree = false;
+bool actor_mcts_lazy_expansion = false;
+bool actor_mcts_transposition_table = false;
+bool actor_mcts_transposition_merge_statistics = false;
+std::string actor_mcts_hidden_state_precision = "fp32";
 char actor_mcts_value_flipping_player = 'W';
 bool actor_select_action_by_count = false;
 bool actor_select_action_by_softmax_count = true;
 float actor_select_action_softmax_temperature = 1.0f;
 bool actor_select_action_softmax_temperature_decay = false;
 bool actor_use_random_rotation_features = true;
+std::string actor_symmetry_rotations = "";
 bool actor_use_dirichlet_noise = true;
 float actor_dirichlet_noise_alpha = 0.03f;
 float actor_dirichlet_noise_epsilon = 0.25f;
@@ -44,6 +54,13 @@ int zero_replay_buffer = 20;
 float zero_disable_resign_ratio = 0.1;
 int zero_actor_intermediate_sequence_length = 0;
 std::string zero_actor_ignored_command = "reset_actors";
+int zero_actor_num_cohorts = 1;
+int zero_actor_inference_max_batch_size = 0;
+int zero_actor_inference_timeout = 1000;
+int zero_actor_profile_interval = 0;
+std::string zero_actor_profile_file = "";
+int zero_actor_nn_cache_size = 0;
+bool zero_actor_deduplicate_batch = true;
 bool zero_server_accept_different_model_games = true;
 
 // learner parameters
@@ -68,6 +85,8 @@ int nn_num_blocks = 1;
 int nn_num_hidden_channels = 256;
 int nn_num_value_hidden_channels = 256;
 std::string nn_type_name = "alphazero";
+std::string nn_cpu_precision = "fp32";
+int nn_cpu_num_threads = 0;
 
 // environment parameters
 int env_board_size = 0;
@@ -88,6 +107,7 @@ void setConfiguration(ConfigureLoader& cl)
     cl.addParameter("program_seed", program_seed, "assign a program seed", "Program");
     cl.addParameter("program_auto_seed", program_auto_seed, "true for assigning a random seed automatically", "Program");
     cl.addParameter("program_quiet", program_quiet, "true for silencing the error message", "Program");
+    cl.addParameter("program_thread_affinity", program_thread_affinity, "the CPUs to pin the worker threads of self-play and the learner to: empty for no pinning, auto for filling the CPUs of a NUMA node before the next one, or a CPU list (e.g., 0-7,16-23), skipping the CPUs not allowed for the process (e.g., by taskset); the self-play actors are created on and only stolen within the NUMA nodes of their threads", "Program");
 
     // actor parameters
     cl.addParameter("actor_num_simulation", actor_num_simulation, "simulation number of MCTS", "Actor");
@@ -95,13 +115,22 @@ void setConfiguration(ConfigureLoader& cl)
     cl.addParameter("actor_mcts_puct_init", actor_mcts_puct_init, "hyperparameter for puct_bias in the PUCT formula of MCTS", "Actor");                                       // ref: AZ, Sec. Methods
     cl.addParameter("actor_mcts_reward_discount", actor_mcts_reward_discount, "discount factor for calculating Q values", "Actor");                                           // ref: MZ, Sec. Methods
     cl.addParameter("actor_mcts_value_rescale", actor_mcts_value_rescale, "true for games whose rewards are not bounded in [-1, 1], e.g., Atari games", "Actor");             // ref: MZ
+    cl.addParameter("actor_mcts_use_puct_kernel", actor_mcts_use_puct_kernel, "true for scoring all children of a node in one pass by the vectorized PUCT kernel over their contiguous statistics", "Actor");
+    cl.addParameter("actor_mcts_reuse_tree", actor_mcts_reuse_tree, "true for reusing the subtree of the played actions in the next search; the search only runs the remaining simulations", "Actor");
+    cl.addParameter("actor_mcts_lazy_expansion", actor_mcts_lazy_expansion, "true for keeping only the sorted candidates of non-root nodes and materializing a child when it is first selected, so that the tree memory scales with the visited nodes", "Actor");
+    cl.addParameter("actor_mcts_transposition_table", actor_mcts_transposition_table, "true for reusing the network evaluation of a position reached by another path in the same search; only works for AlphaZero in games that support transposition hash keys (go, nogo, killallgo, tictactoe, gomoku, othello, and chess)", "Actor");
+    cl.addParameter("actor_mcts_transposition_merge_statistics", actor_mcts_transposition_merge_statistics, "true for backing up the mean value of the node that first evaluated the position instead of the network value when a transposition is found", "Actor");
+    cl.addParameter("actor_mcts_hidden_state_precision", actor_mcts_hidden_state_precision, "the precision to store the MuZero hidden states of the tree in: fp32, fp16, or bf16 (halving the memory of the hidden states)", "Actor");
     cl.addParameter("actor_mcts_think_batch_size", actor_mcts_think_batch_size, "the MCTS selection batch size; only works when running console", "Actor");
+    cl.addParameter("actor_mcts_self_play_batch_size", actor_mcts_self_play_batch_size, "the number of leaves each actor selects with virtual loss per network forward; only works when running self-play without zero_actor_inference_max_batch_size", "Actor");
     cl.addParameter("actor_mcts_think_time_limit", actor_mcts_think_time_limit, "the MCTS time limit in seconds, 0 represents disabling time limit (only uses actor_num_simulation); only works when running console", "Actor");
+    cl.addParameter("actor_mcts_think_num_threads", actor_mcts_think_num_threads, "the number of threads searching the same tree, each with actor_mcts_think_batch_size leaves per network forward; only works when running console, and falls back to 1 with actor_mcts_value_rescale, actor_mcts_use_puct_kernel, actor_mcts_lazy_expansion, actor_mcts_transposition_table, or actor_use_gumbel", "Actor");
     cl.addParameter("actor_select_action_by_count", actor_select_action_by_count, "true for selecting the action by the maximum MCTS count; should not be true together with actor_select_action_by_softmax_count", "Actor");
     cl.addParameter("actor_select_action_by_softmax_count", actor_select_action_by_softmax_count, "true for selecting the action by the propotion of MCTS count; should not be true together with actor_select_action_by_count", "Actor");
     cl.addParameter("actor_select_action_softmax_temperature", actor_select_action_softmax_temperature, "the softmax temperature when using actor_select_action_by_softmax_count", "Actor");
     cl.addParameter("actor_select_action_softmax_temperature_decay", actor_select_action_softmax_temperature_decay, "true for decaying the temperature based on training iteration; set 1, 0.5, and 0.25 for 0%-50%, 50%-75%, and 75%-100% of total iterations, respectively", "Actor"); // ref: MZ
     cl.addParameter("actor_use_random_rotation_features", actor_use_random_rotation_features, "true for randomly rotating input features; only supports in alphazero", "Actor");
+    cl.addParameter("actor_symmetry_rotations", actor_symmetry_rotations, "the rotations (0~7, see utils::Rotation) to evaluate each position in, the network outputs of all rotations are averaged; format: rotation1 rotation2 ..., e.g., 0 1 2 3 4 5 6 7 for all the symmetries; empty for a single evaluation (replaces actor_use_random_rotation_features if set); only supports in alphazero", "Actor");
     cl.addParameter("actor_use_dirichlet_noise", actor_use_dirichlet_noise, "true for adding dirchlet noise to the policy", "Actor");                                          // ref: AZ, Sec. Methods
     cl.addParameter("actor_dirichlet_noise_alpha", actor_dirichlet_noise_alpha, "hyperparameter for dirchlet noise, usually (1 / sqrt(number of actions))", "Actor");          // ref: AZ, Sec. Methods
     cl.addParameter("actor_dirichlet_noise_epsilon", actor_dirichlet_noise_epsilon, "hyperparameter for dirchlet noise", "Actor");                                             // ref: AZ, Sec. Methods
@@ -124,6 +153,13 @@ void setConfiguration(ConfigureLoader& cl)
     cl.addParameter("zero_disable_resign_ratio", zero_disable_resign_ratio, "the probability to keep playing when the winrate is below actor_resign_threshold", "Zero");                                                       // ref: AZ, Sec. Methods
     cl.addParameter("zero_actor_intermediate_sequence_length", zero_actor_intermediate_sequence_length, "the max sequence length when running self-play; usually 0 (unlimited) for board games, 200 for atari games", "Zero"); // ref: MZ
     cl.addParameter("zero_actor_ignored_command", zero_actor_ignored_command, "the commands to ignore by the actor; format: command1 command2 ...", "Zero");
+    cl.addParameter("zero_actor_num_cohorts", zero_actor_num_cohorts, "the number of actor cohorts; 1 for alternating between search and network evaluation, 2 or more for pipelining the search of one cohort with the network evaluation of another (each cohort loads its own network on every GPU)", "Zero");
+    cl.addParameter("zero_actor_inference_max_batch_size", zero_actor_inference_max_batch_size, "the maximum batch size of the inference service of each network; 0 for evaluating the actors in rounds, positive for running the actors asynchronously with a dedicated inference thread per network (AlphaZero only)", "Zero");
+    cl.addParameter("zero_actor_inference_timeout", zero_actor_inference_timeout, "the time (microseconds) that the inference service waits for a batch to fill after its first request", "Zero");
+    cl.addParameter("zero_actor_profile_interval", zero_actor_profile_interval, "the interval (seconds) to report the self-play profile, i.e., the time of each phase and the histograms of batch sizes and move latencies, as one JSON line; 0 for disabling the profiling", "Zero");
+    cl.addParameter("zero_actor_profile_file", zero_actor_profile_file, "the file to append the self-play profile to; empty for stderr", "Zero");
+    cl.addParameter("zero_actor_nn_cache_size", zero_actor_nn_cache_size, "the memory (MB) of the network evaluation cache shared by the self-play actors, keyed by the transposition hash key and the feature rotation; 0 for disabling the cache; only works for AlphaZero in games that support transposition hash keys (go, nogo, killallgo, tictactoe, gomoku, othello, and chess)", "Zero");
+    cl.addParameter("zero_actor_deduplicate_batch", zero_actor_deduplicate_batch, "true for evaluating the identical inputs in a network batch once, e.g., the initial positions of all actors after reset_actors; only works for AlphaZero", "Zero");
     cl.addParameter("zero_server_accept_different_model_games", zero_server_accept_different_model_games, "true for accepting self-play games generated by out-of-date model", "Zero");
 
     // learner parameters
@@ -148,6 +184,8 @@ void setConfiguration(ConfigureLoader& cl)
     cl.addParameter("nn_num_hidden_channels", nn_num_hidden_channels, "hyperparameter for the model; the size of the hidden channels in residual blocks", "Network");               // ref: AGZ
     cl.addParameter("nn_num_value_hidden_channels", nn_num_value_hidden_channels, "hyperparameter for the model; the size of the hidden channels in the value network", "Network"); // ref: AGZ
     cl.addParameter("nn_type_name", nn_type_name, "the type of training algorithm and network: alphazero/muzero", "Network");
+    cl.addParameter("nn_cpu_precision", nn_cpu_precision, "the precision of the networks on CPUs (used when no GPU is available): fp32/bf16; bf16 needs a CPU with bf16 instructions, and the int8 models from learner/quantize.py (only their linear heads are quantized) always run in fp32", "Network");
+    cl.addParameter("nn_cpu_num_threads", nn_cpu_num_threads, "the number of intra-op threads of the networks on CPUs; 0 for the default of LibTorch", "Network");
 
     // environment parameters
     cl.addParameter("env_board_size", env_board_size, "the size of board", "Environment");
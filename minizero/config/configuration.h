@@ -9,6 +9,7 @@ namespace minizero::config {
 extern int program_seed;
 extern bool program_auto_seed;
 extern bool program_quiet;
+extern std::string program_thread_affinity;
 
 // actor parameters
 extern int actor_num_simulation;
@@ -16,14 +17,23 @@ extern float actor_mcts_puct_base;
 extern float actor_mcts_puct_init;
 extern float actor_mcts_reward_discount;
 extern int actor_mcts_think_batch_size;
+extern int actor_mcts_self_play_batch_size;
 extern float actor_mcts_think_time_limit;
+extern int actor_mcts_think_num_threads;
 extern bool actor_mcts_value_rescale;
+extern bool actor_mcts_use_puct_kernel;
+extern bool actor_mcts_reuse_tree;
+extern bool actor_mcts_lazy_expansion;
+extern bool actor_mcts_transposition_table;
+extern bool actor_mcts_transposition_merge_statistics;
+extern std::string actor_mcts_hidden_state_precision;
 extern char actor_mcts_value_flipping_player;
 extern bool actor_select_action_by_count;
 extern bool actor_select_action_by_softmax_count;
 extern float actor_select_action_softmax_temperature;
 extern bool actor_select_action_softmax_temperature_decay;
 extern bool actor_use_random_rotation_features;
+extern std::string actor_symmetry_rotations;
 extern bool actor_use_dirichlet_noise;
 extern float actor_dirichlet_noise_alpha;
 extern float actor_dirichlet_noise_epsilon;
@@ -46,6 +56,13 @@ extern int zero_replay_buffer;
 extern float zero_disable_resign_ratio;
 extern int zero_actor_intermediate_sequence_length;
 extern std::string zero_actor_ignored_command;
+extern int zero_actor_num_cohorts;
+extern int zero_actor_inference_max_batch_size;
+extern int zero_actor_inference_timeout;
+extern int zero_actor_profile_interval;
+extern std::string zero_actor_profile_file;
+extern int zero_actor_nn_cache_size;
+extern bool zero_actor_deduplicate_batch;
 extern bool zero_server_accept_different_model_games;
 
 // learner parameters
@@ -70,6 +87,8 @@ extern int nn_num_blocks;
 extern int nn_num_hidden_channels;
 extern int nn_num_value_hidden_channels;
 extern std::string nn_type_name;
+extern std::string nn_cpu_precision;
+extern int nn_cpu_num_threads;
 
 // environment parameters
 extern int env_board_size;
@@ -0,0 +1,498 @@
+#include "benchmark.h"
+#include "configuration.h"
+#include "create_actor.h"
+#include "create_network.h"
+#include "mcts.h"
+#include "paralleler.h"
+#include "puct_kernel.h"
+#include "random.h"
+#include "thread_affinity.h"
+#include "time_system.h"
+#include "tree_value_bound.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <torch/cuda.h>
+#include <utility>
+#include <vector>
+
+namespace minizero::console {
+
+using namespace minizero::actor;
+
+namespace {
+
+void updateMapValueBound(std::map<float, int>& value_bound, float old_value, float new_value)
+{
+    // same as MCTS::updateTreeValueBound before TreeValueBound
+    if (value_bound.count(old_value)) {
+        --value_bound[old_value];
+        if (value_bound[old_value] == 0) { value_bound.erase(old_value); }
+    }
+    ++value_bound[new_value];
+}
+
+bool isSameValueBound(const std::map<float, int>& map_value_bound, const TreeValueBound& tree_value_bound)
+{
+    // the bounds of a single value are the value itself in both
+    if (static_cast<int>(map_value_bound.size()) != tree_value_bound.getNumValues()) { return false; }
+    if ((map_value_bound.size() >= 2) != tree_value_bound.hasBound()) { return false; }
+    if (map_value_bound.empty()) { return true; }
+    return (map_value_bound.begin()->first == tree_value_bound.getLowerBound() && map_value_bound.rbegin()->first == tree_value_bound.getUpperBound());
+}
+
+bool checkValueBoundUpdates(const std::string& name, const std::vector<std::pair<float, float>>& updates)
+{
+    // apply the updates to both and compare the bounds after each of them
+    std::map<float, int> map_value_bound;
+    TreeValueBound tree_value_bound;
+    bool is_same_bound = isSameValueBound(map_value_bound, tree_value_bound);
+    for (size_t i = 0; i < updates.size() && is_same_bound; ++i) {
+        updateMapValueBound(map_value_bound, updates[i].first, updates[i].second);
+        tree_value_bound.update(updates[i].first, updates[i].second);
+        if (isSameValueBound(map_value_bound, tree_value_bound)) { continue; }
+        std::cout << "[" << name << "] update " << i << " (" << updates[i].first << " -> " << updates[i].second << ")"
+                  << ", std::map: " << map_value_bound.size() << " values (" << map_value_bound.begin()->first << ", " << map_value_bound.rbegin()->first << ")"
+                  << ", TreeValueBound: " << tree_value_bound.getNumValues() << " values (" << tree_value_bound.getLowerBound() << ", " << tree_value_bound.getUpperBound() << ")" << std::endl;
+        is_same_bound = false;
+    }
+    std::cout << "[" << name << "] " << updates.size() << " updates, same bounds as std::map: " << (is_same_bound ? "true" : "false") << std::endl;
+    return is_same_bound;
+}
+
+// records the updates of the value bound for replaying
+class ValueBoundRecordingMCTS : public MCTS {
+public:
+    ValueBoundRecordingMCTS(uint64_t tree_node_size)
+        : MCTS(tree_node_size) {}
+
+    inline const std::vector<std::pair<float, float>>& getUpdates() const { return updates_; }
+
+protected:
+    void updateTreeValueBound(float old_value, float new_value) override
+    {
+        MCTS::updateTreeValueBound(old_value, new_value);
+        updates_.emplace_back(old_value, new_value);
+    }
+
+private:
+    std::vector<std::pair<float, float>> updates_;
+};
+
+double runActorRounds(int num_threads, bool work_stealing, const std::vector<int>& actor_costs, int num_rounds)
+{
+    // emulate the CPU phase of ActorGroup: the threads wait at a barrier, run all actors, then wait at another barrier
+    // return the average wall time of a round in microseconds
+    const int num_actors = actor_costs.size();
+    bool done = false;
+    int actor_index = 0;
+    std::mutex mutex;
+    utils::WorkStealingRanges actor_ranges;
+    std::atomic<float> sink(0.0f);
+    boost::barrier start_barrier(num_threads + 1), finish_barrier(num_threads + 1);
+    auto getActorIndex = [&](int thread_id) {
+        if (work_stealing) { return actor_ranges.getNextIndex(thread_id); }
+        std::lock_guard<std::mutex> lock(mutex); // same as ThreadSharedData::getAvailableActorIndex before WorkStealingRanges
+        return (actor_index < num_actors ? actor_index++ : -1);
+    };
+    auto runThread = [&](int thread_id) {
+        while (true) {
+            start_barrier.wait();
+            if (done) { break; }
+            float value = 0.0f;
+            for (int actor_id = getActorIndex(thread_id); actor_id != -1; actor_id = getActorIndex(thread_id)) {
+                for (int i = 0; i < actor_costs[actor_id]; ++i) { value = value * 0.999f + 1.0f; }
+            }
+            sink = sink + value;
+            finish_barrier.wait();
+        }
+    };
+
+    boost::thread_group threads;
+    for (int id = 0; id < num_threads; ++id) { threads.create_thread(boost::bind<void>(runThread, id)); }
+    double total_time = 0.0;
+    for (int round = 0; round < num_rounds; ++round) {
+        actor_index = 0;
+        actor_ranges.reset(num_threads, num_actors);
+        boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+        start_barrier.wait();
+        finish_barrier.wait();
+        total_time += (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+    }
+    done = true;
+    start_barrier.wait();
+    threads.join_all();
+    return total_time / num_rounds;
+}
+
+std::vector<double> runTreeArenaUpdates(const std::vector<int>& thread_cpus, bool is_first_touched_by_owner)
+{
+    // each thread owns the arenas of a few actors and updates their nodes at random, emulating the expansions and backups of the searches
+    // return the throughput of each thread in million updates per second
+    const int num_threads = thread_cpus.size();
+    const int num_arenas_per_thread = 4;
+    const size_t arena_size = 1 << 21; // 8 MB of floats
+    const int num_updates = 1 << 24;
+    std::vector<std::vector<float*>> arenas(num_threads, std::vector<float*>(num_arenas_per_thread));
+    auto allocateArenas = [&](int thread_id) {
+        // the pages are placed on the NUMA node of the thread touching them first
+        for (auto& arena : arenas[thread_id]) {
+            arena = static_cast<float*>(std::calloc(arena_size, sizeof(float)));
+            std::fill(arena, arena + arena_size, 0.0f);
+        }
+    };
+    if (!is_first_touched_by_owner) {
+        for (int id = 0; id < num_threads; ++id) { allocateArenas(id); }
+    }
+
+    std::vector<double> throughputs(num_threads);
+    boost::barrier barrier(num_threads);
+    auto runThread = [&](int thread_id) {
+        if (thread_cpus[thread_id] != -1) { utils::pinCurrentThread(thread_cpus[thread_id]); }
+        if (is_first_touched_by_owner) { allocateArenas(thread_id); }
+        barrier.wait();
+        boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+        uint32_t random = thread_id + 1;
+        for (int i = 0; i < num_updates; ++i) {
+            random = random * 1664525 + 1013904223;
+            arenas[thread_id][i % num_arenas_per_thread][(random >> 8) & (arena_size - 1)] += 1.0f;
+        }
+        throughputs[thread_id] = static_cast<double>(num_updates) / (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+    };
+
+    boost::thread_group threads;
+    for (int id = 0; id < num_threads; ++id) { threads.create_thread(boost::bind<void>(runThread, id)); }
+    threads.join_all();
+    for (auto& thread_arenas : arenas) {
+        for (auto& arena : thread_arenas) { std::free(arena); }
+    }
+    return throughputs;
+}
+
+std::vector<std::vector<float>> getRandomGamePositions(int num_positions)
+{
+    // the features of the positions in random games, the same positions in every call
+    std::vector<std::vector<float>> positions;
+    std::mt19937 generator(0);
+    Environment env;
+    env.reset();
+    while (static_cast<int>(positions.size()) < num_positions) {
+        std::vector<Action> legal_actions = env.getLegalActions();
+        if (env.isTerminal() || legal_actions.empty()) {
+            env.reset();
+            continue;
+        }
+        positions.push_back(env.getFeatures());
+        env.act(legal_actions[generator() % legal_actions.size()]);
+    }
+    return positions;
+}
+
+struct CPUInferenceResult {
+    double positions_per_second_;
+    std::vector<std::vector<float>> policies_;
+    std::vector<float> values_;
+};
+
+CPUInferenceResult runCPUNetwork(const std::string& nn_file_name, const std::vector<std::vector<float>>& positions, int batch_size)
+{
+    // evaluate the positions in batches with the model loaded on the CPUs, after one batch to warm up
+    std::shared_ptr<network::Network> network = network::createNetwork(nn_file_name, -1);
+    network->reserveBatchSize(batch_size);
+    auto forward = [&network, &positions](int begin, int end) {
+        if (network->getNetworkTypeName() == "alphazero") {
+            std::shared_ptr<network::AlphaZeroNetwork> alphazero_network = std::static_pointer_cast<network::AlphaZeroNetwork>(network);
+            for (int i = begin; i < end; ++i) { alphazero_network->pushBack(positions[i]); }
+            return alphazero_network->forward();
+        } else {
+            std::shared_ptr<network::MuZeroNetwork> muzero_network = std::static_pointer_cast<network::MuZeroNetwork>(network);
+            for (int i = begin; i < end; ++i) { muzero_network->pushBackInitialData(positions[i]); }
+            return muzero_network->initialInference();
+        }
+    };
+    const int num_positions = positions.size();
+    forward(0, std::min(batch_size, num_positions));
+
+    CPUInferenceResult result;
+    boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+    for (int begin = 0; begin < num_positions; begin += batch_size) {
+        for (const auto& output : forward(begin, std::min(begin + batch_size, num_positions))) {
+            if (network->getNetworkTypeName() == "alphazero") {
+                std::shared_ptr<network::AlphaZeroNetworkOutput> alphazero_output = std::static_pointer_cast<network::AlphaZeroNetworkOutput>(output);
+                result.policies_.emplace_back(alphazero_output->policy_.begin(), alphazero_output->policy_.end());
+                result.values_.push_back(alphazero_output->value_);
+            } else {
+                std::shared_ptr<network::MuZeroNetworkOutput> muzero_output = std::static_pointer_cast<network::MuZeroNetworkOutput>(output);
+                result.policies_.emplace_back(muzero_output->policy_.begin(), muzero_output->policy_.end());
+                result.values_.push_back(muzero_output->value_);
+            }
+        }
+    }
+    result.positions_per_second_ = num_positions * 1e6 / (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+    return result;
+}
+
+} // namespace
+
+void Benchmark::runPUCTKernel()
+{
+    // compare the PUCT selection kernels at 19x19 Go (362) and chess (1968) branching factors
+    const int num_iterations = 100000;
+    for (int num_children : {362, 1968}) {
+        std::vector<float> policy(num_children), count(num_children), mean(num_children), virtual_loss(num_children), reward(num_children, 0.0f);
+        for (int i = 0; i < num_children; ++i) {
+            policy[i] = utils::Random::randReal() / num_children;
+            count[i] = (utils::Random::randInt() % 2 == 0 ? 0.0f : utils::Random::randInt() % 100);
+            mean[i] = utils::Random::randReal(2.0f) - 1.0f;
+            virtual_loss[i] = (utils::Random::randInt() % 10 == 0 ? 1.0f : 0.0f);
+        }
+        PUCTChildren children{num_children, policy.data(), count.data(), mean.data(), virtual_loss.data(), reward.data()};
+        PUCTParameters parameters{800, 1.25f, 19652.0f, 1.0f, false, false, false, 0.0f, 0.0f};
+
+        int scalar_selected = -1;
+        double scalar_time = 0.0;
+        for (int type = 0; type < static_cast<int>(PUCTKernelType::kPUCTKernelTypeSize); ++type) {
+            PUCTKernelType kernel_type = static_cast<PUCTKernelType>(type);
+            if (!isPUCTKernelTypeSupported(kernel_type)) {
+                std::cout << "[" << num_children << " children] " << getPUCTKernelTypeString(kernel_type) << ": not supported" << std::endl;
+                continue;
+            }
+
+            PUCTKernel kernel(kernel_type);
+            int selected = -1;
+            boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+            for (int i = 0; i < num_iterations; ++i) {
+                parameters.total_simulation_ = 800 + (i & 1); // avoid the compiler hoisting the kernel out of the loop
+                selected = kernel.selectChild(children, parameters);
+            }
+            double spent_time = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+            if (kernel_type == PUCTKernelType::kScalar) {
+                scalar_selected = selected;
+                scalar_time = spent_time;
+            }
+            std::cout << "[" << num_children << " children] " << getPUCTKernelTypeString(kernel_type)
+                      << ": " << std::fixed << std::setprecision(1) << spent_time * 1000 / num_iterations << " ns/selection"
+                      << ", speedup: " << std::setprecision(2) << scalar_time / spent_time << "x"
+                      << ", same selection as scalar: " << (selected == scalar_selected ? "true" : "false") << std::endl;
+        }
+    }
+}
+
+void Benchmark::runSearchThreads()
+{
+    // search the initial position with the shared tree and report simulations per second for 1 to 64 threads
+    const int num_searches = 3;
+    const int max_num_threads = 64;
+    std::shared_ptr<network::Network> network = network::createNetwork(config::nn_file_name, (torch::cuda::is_available() ? 0 : -1));
+    network->reserveBatchSize(config::actor_mcts_think_batch_size * max_num_threads);
+    uint64_t tree_node_size = MCTS::getTreeNodeSize(config::actor_num_simulation, network->getActionSize());
+    std::shared_ptr<ZeroActor> actor = std::static_pointer_cast<ZeroActor>(createActor(tree_node_size, network));
+    const int think_num_threads = config::actor_mcts_think_num_threads;
+    config::actor_mcts_think_num_threads = max_num_threads;
+    if (!actor->isMultiThreadSearch()) {
+        std::cerr << "the search threads benchmark is skipped since every search would run in one thread" << std::endl;
+        config::actor_mcts_think_num_threads = think_num_threads;
+        return;
+    }
+    config::actor_mcts_think_time_limit = 0;
+    actor->think(); // warmup
+
+    double single_thread_speed = 0.0;
+    for (int num_threads = 1; num_threads <= max_num_threads; num_threads *= 2) {
+        config::actor_mcts_think_num_threads = num_threads;
+        double total_simulation = 0.0, total_seconds = 0.0;
+        for (int i = 0; i < num_searches; ++i) {
+            actor->reset();
+            boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+            actor->think();
+            total_seconds += (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds() / 1e6;
+            total_simulation += actor->getMCTS()->getNumSimulation();
+        }
+        double speed = total_simulation / total_seconds;
+        if (num_threads == 1) { single_thread_speed = speed; }
+        std::cout << "[" << num_threads << " threads] " << std::fixed << std::setprecision(1) << speed << " simulations/s"
+                  << ", speedup: " << std::setprecision(2) << speed / single_thread_speed << "x" << std::endl;
+    }
+    config::actor_mcts_think_num_threads = think_num_threads;
+}
+
+void Benchmark::runTreeValueBound()
+{
+    // run the select/expand/backup loop with value rescaling at Atari (18) and 2048 (4) branching factors, then replay its value bound updates
+    const int num_searches = 100;
+    const int num_simulations = 800;
+    const bool value_rescale = config::actor_mcts_value_rescale;
+    config::actor_mcts_value_rescale = true;
+    for (int num_children : {18, 4}) {
+        std::vector<MCTS::ActionCandidate> candidates;
+        for (int i = 0; i < num_children; ++i) { candidates.emplace_back(Action(i, env::Player::kPlayer1), 1.0f / num_children, 0.0f); }
+        auto search = [&](MCTS& mcts) {
+            for (int i = 0; i < num_searches; ++i) {
+                mcts.reset();
+                for (int sim = 0; sim < num_simulations; ++sim) {
+                    std::vector<MCTSNode*> node_path = mcts.select();
+                    mcts.expand(node_path.back(), candidates);
+                    mcts.backup(node_path, utils::Random::randReal(2.0f) - 1.0f, utils::Random::randInt() % 4);
+                }
+            }
+        };
+
+        uint64_t tree_node_size = MCTS::getTreeNodeSize(num_simulations, num_children);
+        MCTS mcts(tree_node_size);
+        boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+        search(mcts);
+        double search_time = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+        ValueBoundRecordingMCTS recording_mcts(tree_node_size);
+        search(recording_mcts);
+
+        // replay the updates, each followed by reading the bounds as getNormalizedMean does
+        const std::vector<std::pair<float, float>>& updates = recording_mcts.getUpdates();
+        std::map<float, int> map_value_bound;
+        double lower_bound_sum = 0.0; // keeps the reads from being optimized out
+        start_ptime = utils::TimeSystem::getLocalTime();
+        for (const auto& update : updates) {
+            updateMapValueBound(map_value_bound, update.first, update.second);
+            lower_bound_sum += map_value_bound.begin()->first;
+        }
+        double map_time = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+        TreeValueBound tree_value_bound;
+        start_ptime = utils::TimeSystem::getLocalTime();
+        for (const auto& update : updates) {
+            tree_value_bound.update(update.first, update.second);
+            lower_bound_sum -= tree_value_bound.getLowerBound();
+        }
+        double tree_value_bound_time = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+
+        std::cout << "[" << num_children << " children] search: " << std::fixed << std::setprecision(1) << num_searches * num_simulations / (search_time / 1e6) << " simulations/s"
+                  << ", std::map: " << map_time * 1000 / updates.size() << " ns/update"
+                  << ", TreeValueBound: " << tree_value_bound_time * 1000 / updates.size() << " ns/update"
+                  << ", speedup: " << std::setprecision(2) << map_time / tree_value_bound_time << "x" << std::endl;
+    }
+    config::actor_mcts_value_rescale = value_rescale;
+}
+
+bool Benchmark::checkTreeValueBound()
+{
+    // compare TreeValueBound with the std::map<float, int> it replaces, no model is needed
+    bool is_same_bound = true;
+    is_same_bound &= checkValueBoundUpdates("zero", {{1.0f, 0.0f}, {1.0f, -0.0f}, {0.0f, 1.0f}, {-0.0f, -1.0f}, {1.0f, -0.0f}, {-1.0f, 0.0f}, {0.0f, 2.0f}, {-0.0f, -0.0f}});
+    is_same_bound &= checkValueBoundUpdates("not inserted", {{0.5f, 1.0f}, {0.5f, 2.0f}, {-0.5f, 3.0f}, {0.5f, 2.0f}, {4.0f, 1.0f}, {0.0f, 3.0f}});
+    is_same_bound &= checkValueBoundUpdates("one value", {{0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 2.0f}, {2.0f, 2.0f}, {2.0f, -1.0f}, {3.0f, -1.0f}, {-1.0f, -1.0f}});
+
+    // a fixed-seed sequence like the backups of a search: each update moves the mean of a node, new nodes start from a value that may not be in the tree
+    // the values are drawn from a small grid (including -0.0f) to repeat values, or from the reals to grow the hash table and the heaps
+    const int num_updates = 1000000;
+    const int max_num_nodes = 4096;
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<float> real_distribution(-1.0f, 1.0f);
+    auto randomValue = [&]() {
+        if (generator() % 4 == 0) { return real_distribution(generator); }
+        int grid = static_cast<int>(generator() % 65) - 32;
+        return (grid == 0 && generator() % 2 ? -0.0f : grid / 32.0f);
+    };
+    std::vector<float> node_means;
+    std::vector<std::pair<float, float>> updates;
+    for (int i = 0; i < num_updates; ++i) {
+        float new_value = randomValue();
+        if (node_means.empty() || (static_cast<int>(node_means.size()) < max_num_nodes && generator() % 8 == 0)) {
+            updates.emplace_back(randomValue(), new_value);
+            node_means.push_back(new_value);
+        } else {
+            float& node_mean = node_means[generator() % node_means.size()];
+            updates.emplace_back(node_mean, new_value);
+            node_mean = new_value;
+        }
+    }
+    is_same_bound &= checkValueBoundUpdates("random", updates);
+    return is_same_bound;
+}
+
+void Benchmark::runActorScheduler()
+{
+    // measure the CPU phase of 1024 actors at 16, 32 and 64 threads, one in eight actors is 20 times slower to emulate uneven environments (e.g., Atari or chess)
+    const int num_actors = 1024;
+    const int num_rounds = 200;
+    std::vector<int> actor_costs(num_actors);
+    for (int i = 0; i < num_actors; ++i) { actor_costs[i] = (utils::Random::randInt() % 8 == 0 ? 20000 : 1000); }
+
+    for (int num_threads : {16, 32, 64}) {
+        double mutex_time = runActorRounds(num_threads, false, actor_costs, num_rounds);
+        double work_stealing_time = runActorRounds(num_threads, true, actor_costs, num_rounds);
+        std::cout << "[" << num_threads << " threads] mutex: " << std::fixed << std::setprecision(1) << mutex_time << " us/round"
+                  << ", work stealing: " << work_stealing_time << " us/round"
+                  << ", speedup: " << std::setprecision(2) << mutex_time / work_stealing_time << "x" << std::endl;
+    }
+}
+
+void Benchmark::runThreadAffinity()
+{
+    // compare zero_num_threads threads that are not pinned and touch the arenas from the main thread, with threads pinned by program_thread_affinity (auto if empty) that touch their own arenas
+    const int num_threads = config::zero_num_threads;
+    std::vector<int> thread_cpus = utils::getThreadCPUs(config::program_thread_affinity.empty() ? "auto" : config::program_thread_affinity, num_threads);
+    if (thread_cpus.empty()) { thread_cpus.assign(num_threads, -1); }
+    std::vector<double> unpinned_throughputs = runTreeArenaUpdates(std::vector<int>(num_threads, -1), false);
+    std::vector<double> pinned_throughputs = runTreeArenaUpdates(thread_cpus, true);
+
+    double unpinned_total = 0.0, pinned_total = 0.0;
+    for (int id = 0; id < num_threads; ++id) {
+        std::cout << "[thread " << id << "] CPU " << thread_cpus[id] << " (NUMA node " << utils::getNUMANode(thread_cpus[id]) << ")"
+                  << ", unpinned: " << std::fixed << std::setprecision(1) << unpinned_throughputs[id] << " M updates/s"
+                  << ", pinned: " << pinned_throughputs[id] << " M updates/s" << std::endl;
+        unpinned_total += unpinned_throughputs[id];
+        pinned_total += pinned_throughputs[id];
+    }
+    std::cout << "[total] unpinned: " << unpinned_total << " M updates/s, pinned: " << pinned_total << " M updates/s"
+              << ", speedup: " << std::setprecision(2) << pinned_total / unpinned_total << "x" << std::endl;
+}
+
+void Benchmark::runCPUInference()
+{
+    // compare the bf16 model and the int8 model (nn_file_name ending with "_int8.pt" instead of ".pt", by learner/quantize.py) with the fp32 model of nn_file_name on the CPUs
+    // each model evaluates the same 1024 positions of random games in batches of zero_num_parallel_games
+    const int num_positions = 1024;
+    const int batch_size = std::max(1, config::zero_num_parallel_games);
+    std::vector<std::vector<float>> positions = getRandomGamePositions(num_positions);
+    std::string int8_file_name = config::nn_file_name.substr(0, config::nn_file_name.rfind(".pt")) + "_int8.pt";
+
+    network::Network::setCPUOptions("fp32", config::nn_cpu_num_threads);
+    CPUInferenceResult fp32_result = runCPUNetwork(config::nn_file_name, positions, batch_size);
+    std::cout << "[fp32] " << std::fixed << std::setprecision(1) << fp32_result.positions_per_second_ << " positions/s" << std::endl;
+    for (const std::string precision : {"bf16", "int8"}) {
+        network::Network::setCPUOptions((precision == "bf16" ? "bf16" : "fp32"), config::nn_cpu_num_threads);
+        if (precision == "bf16" && !network::Network::useCPUBF16()) {
+            std::cout << "[bf16] skipped since the CPU does not support bf16" << std::endl;
+            continue;
+        }
+        if (precision == "int8" && !std::ifstream(int8_file_name)) {
+            std::cout << "[int8] skipped since " << int8_file_name << " does not exist" << std::endl;
+            continue;
+        }
+
+        CPUInferenceResult result = runCPUNetwork((precision == "bf16" ? config::nn_file_name : int8_file_name), positions, batch_size);
+        int num_same_actions = 0;
+        double value_difference = 0.0, max_value_difference = 0.0;
+        for (int i = 0; i < num_positions; ++i) {
+            const std::vector<float>& fp32_policy = fp32_result.policies_[i];
+            const std::vector<float>& policy = result.policies_[i];
+            if (std::max_element(fp32_policy.begin(), fp32_policy.end()) - fp32_policy.begin() == std::max_element(policy.begin(), policy.end()) - policy.begin()) { ++num_same_actions; }
+            value_difference += std::fabs(fp32_result.values_[i] - result.values_[i]);
+            max_value_difference = std::max(max_value_difference, static_cast<double>(std::fabs(fp32_result.values_[i] - result.values_[i])));
+        }
+        std::cout << "[" << precision << "] " << std::fixed << std::setprecision(1) << result.positions_per_second_ << " positions/s"
+                  << ", speedup: " << std::setprecision(2) << result.positions_per_second_ / fp32_result.positions_per_second_ << "x"
+                  << ", same best action as fp32: " << std::setprecision(1) << 100.0 * num_same_actions / num_positions << "%"
+                  << ", value difference: " << std::setprecision(4) << value_difference / num_positions << " (mean), " << max_value_difference << " (max)" << std::endl;
+    }
+    network::Network::setCPUOptions(config::nn_cpu_precision, config::nn_cpu_num_threads);
+}
+
+} // namespace minizero::console
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+namespace minizero::console {
+
+class Benchmark {
+public:
+    Benchmark() {}
+    virtual ~Benchmark() = default;
+
+    virtual void runPUCTKernel();
+    virtual void runSearchThreads();
+    virtual void runTreeValueBound();
+    virtual bool checkTreeValueBound();
+    virtual void runActorScheduler();
+    virtual void runThreadAffinity();
+    virtual void runCPUInference();
+};
+
+} // namespace minizero::console
@@ -9,6 +9,7 @@
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <torch/cuda.h>
 #include <utility>
 
 namespace minizero::console {
@@ -40,9 +41,12 @@ Console::Console()
 
 void Console::initialize()
 {
-    if (!network_) { network_ = createNetwork(config::nn_file_name, 0); }
+    if (!network_) {
+        network_ = createNetwork(config::nn_file_name, (torch::cuda::is_available() ? 0 : -1));
+        network_->reserveBatchSize(config::actor_mcts_think_batch_size * std::max(1, config::actor_mcts_think_num_threads));
+    }
     if (!actor_) {
-        uint64_t tree_node_size = static_cast<uint64_t>(config::actor_num_simulation + 1) * network_->getActionSize();
+        uint64_t tree_node_size = actor::MCTS::getTreeNodeSize(config::actor_num_simulation, network_->getActionSize());
         actor_ = actor::createActor(tree_node_size, network_);
     }
     actor_->setNetwork(network_);
@@ -179,7 +183,7 @@ void Console::cmdPV(const std::vector<std::string>& args)
 
     float value;
     std::vector<float> policy;
-    utils::Rotation rotation = config::actor_use_random_rotation_features ? static_cast<utils::Rotation>(utils::Random::randInt() % static_cast<int>(utils::Rotation::kRotateSize)) : utils::Rotation::kRotationNone;
+    utils::Rotation rotation = (config::actor_use_random_rotation_features && config::actor_symmetry_rotations.empty()) ? static_cast<utils::Rotation>(utils::Random::randInt() % static_cast<int>(utils::Rotation::kRotateSize)) : utils::Rotation::kRotationNone;
     calculatePolicyValue(policy, value, rotation);
 
     const Environment& env_transition = actor_->getEnvironment();
@@ -221,7 +225,7 @@ void Console::cmdPVString(const std::vector<std::string>& args)
 
     float value;
     std::vector<float> policy;
-    utils::Rotation rotation = config::actor_use_random_rotation_features ? static_cast<utils::Rotation>(utils::Random::randInt() % static_cast<int>(utils::Rotation::kRotateSize)) : utils::Rotation::kRotationNone;
+    utils::Rotation rotation = (config::actor_use_random_rotation_features && config::actor_symmetry_rotations.empty()) ? static_cast<utils::Rotation>(utils::Random::randInt() % static_cast<int>(utils::Rotation::kRotateSize)) : utils::Rotation::kRotationNone;
     calculatePolicyValue(policy, value, rotation);
 
     std::ostringstream oss;
@@ -283,7 +287,7 @@ void Console::calculatePolicyValue(std::vector<float>& policy, float& value, uti
         int index = muzero_network->pushBackInitialData(actor_->getEnvironment().getFeatures());
         std::shared_ptr<NetworkOutput> network_output = muzero_network->initialInference()[index];
         std::shared_ptr<minizero::network::MuZeroNetworkOutput> zero_output = std::static_pointer_cast<minizero::network::MuZeroNetworkOutput>(network_output);
-        policy = zero_output->policy_;
+        policy.assign(zero_output->policy_.begin(), zero_output->policy_.end());
         value = zero_output->value_;
     } else {
         assert(false); // should not be here
@@ -1,5 +1,6 @@
 #include "mode_handler.h"
 #include "actor_group.h"
+#include "benchmark.h"
 #include "console.h"
 #include "git_info.h"
 #include "obs_recover.h"
@@ -23,6 +24,13 @@ ModeHandler::ModeHandler()
     RegisterFunction("env_test", this, &ModeHandler::runEnvTest);
     RegisterFunction("remove_obs", this, &ModeHandler::runRemoveObs);
     RegisterFunction("recover_obs", this, &ModeHandler::runRecoverObs);
+    RegisterFunction("benchmark_puct_kernel", this, &ModeHandler::runBenchmarkPUCTKernel);
+    RegisterFunction("benchmark_search_threads", this, &ModeHandler::runBenchmarkSearchThreads);
+    RegisterFunction("benchmark_tree_value_bound", this, &ModeHandler::runBenchmarkTreeValueBound);
+    RegisterFunction("benchmark_actor_scheduler", this, &ModeHandler::runBenchmarkActorScheduler);
+    RegisterFunction("benchmark_thread_affinity", this, &ModeHandler::runBenchmarkThreadAffinity);
+    RegisterFunction("benchmark_cpu_inference", this, &ModeHandler::runBenchmarkCPUInference);
+    RegisterFunction("check_tree_value_bound", this, &ModeHandler::runCheckTreeValueBound);
 }
 
 void ModeHandler::run(int argc, char* argv[])
@@ -58,6 +66,7 @@ void ModeHandler::run(int argc, char* argv[])
     if (!readConfiguration(cl, config_file, config_string)) { exit(-1); }
     utils::OstreamRedirector::silence(std::cerr, config::program_quiet);                                  // silence std::cerr if program_quiet
     utils::Random::seed(config::program_auto_seed ? static_cast<int>(time(NULL)) : config::program_seed); // setup random seed
+    network::Network::setCPUOptions(config::nn_cpu_precision, config::nn_cpu_num_threads);
 
     if (!gen_config.empty()) {
         // generate configuration file after reading cfg file
@@ -202,4 +211,46 @@ void ModeHandler::runRecoverObs()
 #endif
 }
 
+void ModeHandler::runBenchmarkPUCTKernel()
+{
+    Benchmark benchmark;
+    benchmark.runPUCTKernel();
+}
+
+void ModeHandler::runBenchmarkSearchThreads()
+{
+    Benchmark benchmark;
+    benchmark.runSearchThreads();
+}
+
+void ModeHandler::runBenchmarkTreeValueBound()
+{
+    Benchmark benchmark;
+    benchmark.runTreeValueBound();
+}
+
+void ModeHandler::runBenchmarkActorScheduler()
+{
+    Benchmark benchmark;
+    benchmark.runActorScheduler();
+}
+
+void ModeHandler::runBenchmarkThreadAffinity()
+{
+    Benchmark benchmark;
+    benchmark.runThreadAffinity();
+}
+
+void ModeHandler::runBenchmarkCPUInference()
+{
+    Benchmark benchmark;
+    benchmark.runCPUInference();
+}
+
+void ModeHandler::runCheckTreeValueBound()
+{
+    Benchmark benchmark;
+    if (!benchmark.checkTreeValueBound()) { exit(1); }
+}
+
 } // namespace minizero::console
@@ -49,6 +49,13 @@ protected:
     virtual void runEnvTest();
     virtual void runRemoveObs();
     virtual void runRecoverObs();
+    virtual void runBenchmarkPUCTKernel();
+    virtual void runBenchmarkSearchThreads();
+    virtual void runBenchmarkTreeValueBound();
+    virtual void runBenchmarkActorScheduler();
+    virtual void runBenchmarkThreadAffinity();
+    virtual void runBenchmarkCPUInference();
+    virtual void runCheckTreeValueBound();
 
     std::map<std::string, std::shared_ptr<BaseFunction>> function_map_;
 };
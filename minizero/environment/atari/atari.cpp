@@ -1,4 +1,5 @@
 #include "atari.h"
+#include <algorithm>
 #include <opencv2/opencv.hpp>
 #include <utility>
 
@@ -111,14 +112,18 @@ std::vector<AtariAction> AtariEnv::getLegalActions() const
 
 std::vector<float> AtariEnv::getFeatures(utils::Rotation rotation /* = utils::Rotation::kRotationNone */) const
 {
-    std::vector<float> features;
-    features.reserve(kAtariFeatureHistorySize * 4 * kAtariResolution * kAtariResolution);
+    std::vector<float> features(kAtariFeatureHistorySize * 4 * kAtariResolution * kAtariResolution);
+    writeFeatures(features.data(), rotation);
+    return features;
+}
+
+void AtariEnv::writeFeatures(float* features, utils::Rotation rotation /* = utils::Rotation::kRotationNone */) const
+{
+    assert(static_cast<int>(feature_history_.size()) == kAtariFeatureHistorySize && static_cast<int>(action_feature_history_.size()) == kAtariFeatureHistorySize);
     for (int i = 0; i < kAtariFeatureHistorySize; ++i) { // 1 for action; 3 for RGB, action first since the latest observation didn't have action yet
-        features.insert(features.end(), action_feature_history_[i].begin(), action_feature_history_[i].end());
-        features.insert(features.end(), feature_history_[i].begin(), feature_history_[i].end());
+        features = std::copy(action_feature_history_[i].begin(), action_feature_history_[i].end(), features);
+        features = std::copy(feature_history_[i].begin(), feature_history_[i].end(), features);
     }
-    assert(static_cast<int>(features.size()) == kAtariFeatureHistorySize * 4 * kAtariResolution * kAtariResolution);
-    return features;
 }
 
 std::vector<float> AtariEnv::getActionFeatures(const AtariAction& action, utils::Rotation rotation /* = utils::Rotation::kRotationNone */) const
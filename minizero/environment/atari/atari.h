@@ -61,6 +61,7 @@ public:
     float getReward() const override { return reward_; }
     float getEvalScore(bool is_resign = false) const override { return total_reward_; }
     std::vector<float> getFeatures(utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    void writeFeatures(float* features, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     std::vector<float> getActionFeatures(const AtariAction& action, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     inline int getNumInputChannels() const override { return kAtariFeatureHistorySize * 4; }
     inline int getNumActionFeatureChannels() const override { return kAtariActionSize; }
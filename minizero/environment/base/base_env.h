@@ -7,6 +7,7 @@
 #include "vector_map.h"
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <fstream>
 #include <memory>
 #include <sstream>
@@ -85,6 +86,12 @@ public:
     virtual float getReward() const = 0;
     virtual float getEvalScore(bool is_resign = false) const = 0;
     virtual std::vector<float> getFeatures(utils::Rotation rotation = utils::Rotation::kRotationNone) const = 0;
+    virtual void writeFeatures(float* features, utils::Rotation rotation = utils::Rotation::kRotationNone) const
+    {
+        // write the features to a preallocated buffer, environments override this to avoid building the vector
+        const std::vector<float> vFeatures = getFeatures(rotation);
+        std::copy(vFeatures.begin(), vFeatures.end(), features);
+    }
     virtual std::vector<float> getActionFeatures(const Action& action, utils::Rotation rotation = utils::Rotation::kRotationNone) const = 0;
     virtual int getNumInputChannels() const = 0;
     virtual int getNumActionFeatureChannels() const = 0;
@@ -100,6 +107,8 @@ public:
     virtual std::string name() const = 0;
     virtual int getNumPlayer() const = 0;
     virtual void setTurn(Player p) { turn_ = p; }
+    virtual uint64_t getTranspositionHashKey() const { return 0; } // positions with the same key must have the same features, 0 if not supported
+    virtual bool undo() { return false; }                          // take back the last action, false if not supported
 
     inline Player getTurn() const { return turn_; }
     inline const std::vector<Action>& getActionHistory() const { return actions_; }
@@ -114,7 +123,8 @@ protected:
 template <class Action, class Env>
 class BaseEnvLoader {
 public:
-    BaseEnvLoader() {}
+    BaseEnvLoader()
+        : defer_observation_compression_(false) {}
     virtual ~BaseEnvLoader() = default;
 
     typedef minizero::utils::VectorMap<std::string, std::string> Tags;
@@ -211,10 +221,19 @@ public:
         addTag("RE", std::to_string(env.getEvalScore()));
 
         // add observations
-        std::string observations;
-        for (const auto& obs : env.getObservationHistory()) { observations += obs; }
-        addTag("OBS", utils::compressString(observations));
-        assert(observations == utils::decompressString(getTag("OBS")));
+        uncompressed_observations_.clear();
+        for (const auto& obs : env.getObservationHistory()) { uncompressed_observations_ += obs; }
+        addTag("OBS", ""); // keep the tag order of the record when the compression is deferred
+        if (!defer_observation_compression_) { compressObservations(); }
+    }
+
+    void compressObservations()
+    {
+        // called by loadFromEnvironment unless deferred, e.g., to compress the record on another thread
+        addTag("OBS", utils::compressString(uncompressed_observations_));
+        assert(uncompressed_observations_ == utils::decompressString(getTag("OBS")));
+        uncompressed_observations_.clear();
+        uncompressed_observations_.shrink_to_fit();
     }
 
     virtual std::string toString() const
@@ -296,6 +315,7 @@ public:
     inline const std::vector<std::pair<Action, ActionInfo>>& getActionPairs() const { return action_pairs_; }
     inline void addActionPair(const Action& action, const ActionInfo& action_info = {}) { action_pairs_.emplace_back(action, action_info); }
     inline float getReturn() const { return std::stof(getTag("RE")); }
+    inline void setDeferObservationCompression(bool defer) { defer_observation_compression_ = defer; }
 
 protected:
     std::string escapeSGFString(const std::string& str) const
@@ -314,6 +334,8 @@ protected:
     std::string sgf_content_;
     Tags tags_;
     std::vector<std::pair<Action, ActionInfo>> action_pairs_;
+    bool defer_observation_compression_;
+    std::string uncompressed_observations_;
 };
 
 template <int kNumPlayer = 2>
@@ -158,6 +158,7 @@ void ChessEnv::reset()
         board_ = ChessBoard();
         position_history_.push_back(board_.getPositionInfo());
         actions_.clear();
+        undo_records_.clear();
         turn_ = Player::kPlayer1;
     }
 }
@@ -168,6 +169,7 @@ void ChessEnv::setFen(const std::string& fen)
     board_ = ChessBoard(fen);
     position_history_.push_back(board_.getPositionInfo());
     actions_.clear();
+    undo_records_.clear();
     turn_ = board_.player_;
 }
 
@@ -179,6 +181,12 @@ std::string ChessEnv::getFen() const
 bool ChessEnv::act(const ChessAction& action)
 {
     if (isLegalAction(action)) {
+        // keep the board for undo() without copying its hash history
+        std::vector<uint64_t> position_hash_history;
+        position_hash_history.swap(board_.position_hash_history_);
+        undo_records_.push_back({board_, {}});
+        position_hash_history.swap(board_.position_hash_history_);
+
         actions_.push_back(action);
         turn_ = getNextPlayer(board_.player_, kChessNumPlayer);
         // default char with no promotion
@@ -186,6 +194,7 @@ bool ChessEnv::act(const ChessAction& action)
 
         position_history_.push_back(board_.getPositionInfo());
         if (position_history_.size() > 8) {
+            undo_records_.back().dropped_position_ = std::move(position_history_.front());
             position_history_.erase(position_history_.begin());
         }
 
@@ -195,6 +204,24 @@ bool ChessEnv::act(const ChessAction& action)
     return false;
 }
 
+bool ChessEnv::undo()
+{
+    if (actions_.empty()) { return false; }
+    ChessUndoRecord& record = undo_records_.back();
+    std::vector<uint64_t> position_hash_history;
+    position_hash_history.swap(board_.position_hash_history_);
+    position_hash_history.pop_back();
+    board_ = std::move(record.board_);
+    board_.position_hash_history_.swap(position_hash_history);
+
+    position_history_.pop_back();
+    if (!record.dropped_position_.empty()) { position_history_.insert(position_history_.begin(), std::move(record.dropped_position_)); }
+    turn_ = board_.player_;
+    actions_.pop_back();
+    undo_records_.pop_back();
+    return true;
+}
+
 // action_string_args: {player, action_string}, e.g. {"W", "a1b1"}
 bool ChessEnv::act(const std::vector<std::string>& action_string_args)
 {
@@ -280,60 +307,49 @@ std::string ChessEnv::toString() const
 
 std::vector<float> ChessEnv::getFeatures(utils::Rotation rotation) const
 {
-    std::vector<float> features;
-
-    // push last 8 positions
-    for (size_t i = 0; i < 8 - position_history_.size(); i++) {
-        for (int i = 0; i < 64 * 14; i++) {
-            features.push_back(0.0f);
-        }
-    }
+    std::vector<float> features(getNumInputChannels() * 64);
+    writeFeatures(features.data(), rotation);
+    return features;
+}
 
-    for (auto position : position_history_) {
-        // push 14 feature planes
-        for (size_t i = 0; i < position.size() - 2; i++) {
-            for (int j = 0; j < 64; j++) {
-                if (position[i] & (1ULL << j)) {
-                    features.push_back(1.0f);
-                } else {
-                    features.push_back(0.0f);
-                }
-            }
+void ChessEnv::writeFeatures(float* features, utils::Rotation rotation) const
+{
+    // write last 8 positions, the missing ones are filled with zeros
+    const int padding_size = (8 - position_history_.size()) * 64 * 14;
+    std::fill(features, features + padding_size, 0.0f);
+    float* plane = features + padding_size;
+    for (const auto& position : position_history_) {
+        // write 14 feature planes, only visit the pieces
+        std::fill(plane, plane + (position.size() - 2) * 64, 0.0f);
+        for (size_t i = 0; i < position.size() - 2; i++, plane += 64) {
+            for (uint64_t bitboard = position[i]; bitboard; bitboard &= bitboard - 1) { plane[__builtin_ctzll(bitboard)] = 1.0f; }
         }
 
-        int repetition_once = position[position.size() - 2];
-        for (int i = 0; i < 64; i++) {
-            features.push_back(repetition_once);
-        }
-        int repetition_twice = position[position.size() - 1];
-        for (int i = 0; i < 64; i++) {
-            features.push_back(repetition_twice);
-        }
+        std::fill(plane, plane + 64, static_cast<float>(position[position.size() - 2]));
+        plane += 64;
+        std::fill(plane, plane + 64, static_cast<float>(position[position.size() - 1]));
+        plane += 64;
     }
 
-    for (int i = 0; i < 64; i++) {
-        features.push_back((board_.castling_rights_ & 1) ? 1.0f : 0.0f);
-    }
-    for (int i = 0; i < 64; i++) {
-        features.push_back((board_.castling_rights_ & 2) ? 1.0f : 0.0f);
-    }
-    for (int i = 0; i < 64; i++) {
-        features.push_back((board_.castling_rights_ & 4) ? 1.0f : 0.0f);
-    }
-    for (int i = 0; i < 64; i++) {
-        features.push_back((board_.castling_rights_ & 8) ? 1.0f : 0.0f);
-    }
-    for (int i = 0; i < 64; i++) {
-        features.push_back(board_.fifty_move_rule_ / 2);
-    }
-    for (int i = 0; i < 64; i++) {
-        features.push_back(board_.fullmove_number_ / 2);
-    }
-    for (int i = 0; i < 64; i++) {
-        features.push_back(board_.player_ == Player::kPlayer1 ? 1.0f : 0.0f);
-    }
+    std::fill(plane, plane + 64, (board_.castling_rights_ & 1) ? 1.0f : 0.0f);
+    std::fill(plane + 64, plane + 2 * 64, (board_.castling_rights_ & 2) ? 1.0f : 0.0f);
+    std::fill(plane + 2 * 64, plane + 3 * 64, (board_.castling_rights_ & 4) ? 1.0f : 0.0f);
+    std::fill(plane + 3 * 64, plane + 4 * 64, (board_.castling_rights_ & 8) ? 1.0f : 0.0f);
+    std::fill(plane + 4 * 64, plane + 5 * 64, static_cast<float>(board_.fifty_move_rule_ / 2));
+    std::fill(plane + 5 * 64, plane + 6 * 64, static_cast<float>(board_.fullmove_number_ / 2));
+    std::fill(plane + 6 * 64, plane + 7 * 64, board_.player_ == Player::kPlayer1 ? 1.0f : 0.0f);
+}
 
-    return features;
+uint64_t ChessEnv::getTranspositionHashKey() const
+{
+    // the features contain the pieces and the repetitions of the last 8 positions, the castling rights, the move counters, and the turn
+    // the zobrist hash key of the current position also covers the en passant square, which changes the legal actions
+    uint64_t key = board_.generateHash() ^ (position_history_.size() * 3 + static_cast<int>(turn_));
+    for (const auto& position : position_history_) {
+        for (uint64_t bitboard : position) { key = key * 0x9E3779B97F4A7C15ULL ^ bitboard; }
+    }
+    key = key * 0x9E3779B97F4A7C15ULL ^ (static_cast<uint64_t>(board_.fifty_move_rule_) << 32 | board_.fullmove_number_);
+    return (key == 0 ? 1 : key);
 }
 
 std::vector<float> ChessEnv::getActionFeatures(const ChessAction& action, utils::Rotation rotation) const
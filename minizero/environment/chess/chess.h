@@ -41,6 +41,13 @@ public:
     char promotion_;
 };
 
+// the state of a move taken back by ChessEnv::undo()
+class ChessUndoRecord {
+public:
+    ChessBoard board_;                      // the board before the move, without its position hash history which only grows by one hash per move
+    std::vector<uint64_t> dropped_position_; // the position dropped from the front of position_history_ by the move, empty if none
+};
+
 class ChessEnv : public BaseBoardEnv<ChessAction> {
 public:
     ChessEnv() : BaseBoardEnv<ChessAction>(minizero::config::env_board_size)
@@ -59,6 +66,7 @@ public:
     std::string getFen() const;
     bool act(const ChessAction& action) override;
     bool act(const std::vector<std::string>& action_string_args) override;
+    bool undo() override;
     std::vector<ChessAction> getLegalActions() const override;
     bool isLegalAction(const ChessAction& action) const override;
     bool isTerminal() const override;
@@ -66,7 +74,9 @@ public:
 
     float getEvalScore(bool is_resign = false) const override;
     std::vector<float> getFeatures(utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    void writeFeatures(float* features, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     std::vector<float> getActionFeatures(const ChessAction& action, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    uint64_t getTranspositionHashKey() const override;
     inline int getNumInputChannels() const override { return 119; }
     inline int getNumActionFeatureChannels() const override { return 7; }
     inline int getInputChannelHeight() const override { return getBoardSize(); }
@@ -84,6 +94,7 @@ public:
     ChessBoard board_;
     // used for input features
     std::vector<std::vector<uint64_t>> position_history_;
+    std::vector<ChessUndoRecord> undo_records_;
 };
 
 class ChessEnvLoader : public BaseBoardEnvLoader<ChessAction, ChessEnv> {
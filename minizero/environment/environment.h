@@ -72,6 +72,14 @@ inline void setUpEnv()
     go::initialize();
 #endif
 
+#if GOMOKU
+    gomoku::initialize();
+#endif
+
+#if OTHELLO
+    othello::initialize();
+#endif
+
 #if CHESS
     chess::initialize();
     minizero::config::actor_mcts_value_flipping_player = 'B';
@@ -2,6 +2,7 @@
 #include "color_message.h"
 #include "random.h"
 #include "sgf_loader.h"
+#include <algorithm>
 #include <random>
 #include <sstream>
 #include <string>
@@ -278,33 +279,43 @@ float GoEnv::getEvalScore(bool is_resign /*= false*/) const
 }
 
 std::vector<float> GoEnv::getFeatures(utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
+{
+    std::vector<float> vFeatures(getNumInputChannels() * board_size_ * board_size_);
+    writeFeatures(vFeatures.data(), rotation);
+    return vFeatures;
+}
+
+void GoEnv::writeFeatures(float* features, utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
 {
     /* 18 channels:
         0~15. own/opponent position for last 8 turns
         16. black turn
         17. white turn
     */
-    std::vector<float> vFeatures;
-    for (int channel = 0; channel < 18; ++channel) {
-        for (int pos = 0; pos < board_size_ * board_size_; ++pos) {
-            int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
-            if (channel < 16) {
-                int last_n_turn = stone_bitboard_history_.size() - 1 - channel / 2;
-                if (last_n_turn < 0) {
-                    vFeatures.push_back(0.0f);
-                } else {
-                    const GamePair<GoBitboard>& last_n_trun_stone_bitboard = stone_bitboard_history_[last_n_turn];
-                    Player player = (channel % 2 == 0 ? turn_ : getNextPlayer(turn_, kGoNumPlayer));
-                    vFeatures.push_back(last_n_trun_stone_bitboard.get(player).test(rotation_pos) ? 1.0f : 0.0f);
-                }
-            } else if (channel == 16) {
-                vFeatures.push_back((turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
-            } else if (channel == 17) {
-                vFeatures.push_back((turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
-            }
-        }
-    }
-    return vFeatures;
+    const int board_area = board_size_ * board_size_;
+    const std::vector<int>& rotation_table = utils::getRotationTable(rotation, board_size_);
+    std::fill(features, features + 16 * board_area, 0.0f);
+    for (int channel = 0; channel < 16; ++channel) {
+        int last_n_turn = stone_bitboard_history_.size() - 1 - channel / 2;
+        if (last_n_turn < 0) { break; }
+
+        // only visit the stones, the plane is filled with zeros
+        Player player = (channel % 2 == 0 ? turn_ : getNextPlayer(turn_, kGoNumPlayer));
+        const GoBitboard& stone_bitboard = stone_bitboard_history_[last_n_turn].get(player);
+        float* plane = features + channel * board_area;
+        for (int pos = stone_bitboard._Find_first(); pos < board_area; pos = stone_bitboard._Find_next(pos)) { plane[rotation_table[pos]] = 1.0f; }
+    }
+    std::fill(features + 16 * board_area, features + 17 * board_area, (turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
+    std::fill(features + 17 * board_area, features + 18 * board_area, (turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
+}
+
+uint64_t GoEnv::getTranspositionHashKey() const
+{
+    // the features contain the stones of the last 8 turns, so the key combines the hash keys of the last 8 positions
+    const int num_history = std::min(static_cast<int>(hashkey_history_.size()), 8);
+    uint64_t key = num_history * 3 + static_cast<int>(turn_);
+    for (int i = 1; i <= num_history; ++i) { key = key * 0x9E3779B97F4A7C15ULL ^ hashkey_history_[hashkey_history_.size() - i]; }
+    return (key == 0 ? 1 : key);
 }
 
 std::vector<float> GoEnv::getActionFeatures(const GoAction& action, utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
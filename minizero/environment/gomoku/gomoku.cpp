@@ -3,6 +3,7 @@
 #include "random.h"
 #include "sgf_loader.h"
 #include <algorithm>
+#include <random>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -11,10 +12,26 @@ namespace minizero::env::gomoku {
 
 using namespace minizero::utils;
 
+uint64_t turn_hash_key;
+std::vector<GamePair<uint64_t>> grids_hash_key;
+
+void initialize()
+{
+    std::mt19937_64 generator;
+    generator.seed(0);
+    turn_hash_key = generator();
+    grids_hash_key.resize(kMaxGomokuBoardSize * kMaxGomokuBoardSize);
+    for (int pos = 0; pos < kMaxGomokuBoardSize * kMaxGomokuBoardSize; ++pos) {
+        grids_hash_key[pos].get(Player::kPlayer1) = generator();
+        grids_hash_key[pos].get(Player::kPlayer2) = generator();
+    }
+}
+
 void GomokuEnv::reset()
 {
     winner_ = Player::kPlayerNone;
     turn_ = Player::kPlayer1;
+    hash_key_ = 0;
     actions_.clear();
     board_.resize(board_size_ * board_size_);
     fill(board_.begin(), board_.end(), Player::kPlayerNone);
@@ -25,6 +42,7 @@ bool GomokuEnv::act(const GomokuAction& action)
     if (!isLegalAction(action)) { return false; }
     actions_.push_back(action);
     board_[action.getActionID()] = action.getPlayer();
+    hash_key_ ^= grids_hash_key[action.getActionID()].get(action.getPlayer());
     turn_ = action.nextPlayer();
     winner_ = updateWinner(action);
     return true;
@@ -35,6 +53,17 @@ bool GomokuEnv::act(const std::vector<std::string>& action_string_args)
     return act(GomokuAction(action_string_args));
 }
 
+bool GomokuEnv::undo()
+{
+    if (actions_.empty()) { return false; }
+    board_[actions_.back().getActionID()] = Player::kPlayerNone;
+    hash_key_ ^= grids_hash_key[actions_.back().getActionID()].get(actions_.back().getPlayer());
+    turn_ = actions_.back().getPlayer();
+    winner_ = Player::kPlayerNone; // the game ends once there is a winner
+    actions_.pop_back();
+    return true;
+}
+
 std::vector<GomokuAction> GomokuEnv::getLegalActions() const
 {
     std::vector<GomokuAction> actions;
@@ -73,28 +102,32 @@ float GomokuEnv::getEvalScore(bool is_resign /*= false*/) const
 }
 
 std::vector<float> GomokuEnv::getFeatures(utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
+{
+    std::vector<float> vFeatures(getNumInputChannels() * board_size_ * board_size_);
+    writeFeatures(vFeatures.data(), rotation);
+    return vFeatures;
+}
+
+void GomokuEnv::writeFeatures(float* features, utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
 {
     /* 4 channels:
         0~1. own/opponent position
         2. Black's turn
         3. White's turn
     */
-    std::vector<float> vFeatures;
-    for (int channel = 0; channel < 4; ++channel) {
-        for (int pos = 0; pos < board_size_ * board_size_; ++pos) {
-            int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
-            if (channel == 0) {
-                vFeatures.push_back((board_[rotation_pos] == turn_ ? 1.0f : 0.0f));
-            } else if (channel == 1) {
-                vFeatures.push_back((board_[rotation_pos] == getNextPlayer(turn_, kGomokuNumPlayer) ? 1.0f : 0.0f));
-            } else if (channel == 2) {
-                vFeatures.push_back((turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
-            } else if (channel == 3) {
-                vFeatures.push_back((turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
-            }
+    const int board_area = board_size_ * board_size_;
+    const std::vector<int>& rotation_table = utils::getRotationTable(rotation, board_size_);
+    const Player opponent = getNextPlayer(turn_, kGomokuNumPlayer);
+    std::fill(features, features + 2 * board_area, 0.0f);
+    for (int pos = 0; pos < board_area; ++pos) {
+        if (board_[pos] == turn_) {
+            features[rotation_table[pos]] = 1.0f;
+        } else if (board_[pos] == opponent) {
+            features[board_area + rotation_table[pos]] = 1.0f;
         }
     }
-    return vFeatures;
+    std::fill(features + 2 * board_area, features + 3 * board_area, (turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
+    std::fill(features + 3 * board_area, features + 4 * board_area, (turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
 }
 
 std::vector<float> GomokuEnv::getActionFeatures(const GomokuAction& action, utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
@@ -104,6 +137,13 @@ std::vector<float> GomokuEnv::getActionFeatures(const GomokuAction& action, util
     return action_features;
 }
 
+uint64_t GomokuEnv::getTranspositionHashKey() const
+{
+    // the features only contain the stones and the turn
+    uint64_t key = hash_key_ ^ (turn_ == Player::kPlayer2 ? turn_hash_key : 0);
+    return (key == 0 ? 1 : key);
+}
+
 std::string GomokuEnv::toString() const
 {
     int last_move_pos = -1, last2_move_pos = -1;
@@ -12,6 +12,11 @@ const std::string kGomokuName = "gomoku";
 const int kGomokuNumPlayer = 2;
 const int kMaxGomokuBoardSize = 19;
 
+extern uint64_t turn_hash_key;
+extern std::vector<GamePair<uint64_t>> grids_hash_key;
+
+void initialize();
+
 typedef BaseBoardAction<kGomokuNumPlayer> GomokuAction;
 
 class GomokuEnv : public BaseBoardEnv<GomokuAction> {
@@ -25,13 +30,16 @@ public:
     void reset() override;
     bool act(const GomokuAction& action) override;
     bool act(const std::vector<std::string>& action_string_args) override;
+    bool undo() override;
     std::vector<GomokuAction> getLegalActions() const override;
     bool isLegalAction(const GomokuAction& action) const override;
     bool isTerminal() const override;
     float getReward() const override { return 0.0f; }
     float getEvalScore(bool is_resign = false) const override;
     std::vector<float> getFeatures(utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    void writeFeatures(float* features, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     std::vector<float> getActionFeatures(const GomokuAction& action, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    uint64_t getTranspositionHashKey() const override;
     inline int getNumInputChannels() const override { return 4; }
     inline int getPolicySize() const override { return getBoardSize() * getBoardSize(); }
     std::string toString() const override;
@@ -48,6 +56,7 @@ private:
     std::string getCoordinateString() const;
 
     Player winner_;
+    uint64_t hash_key_; // the zobrist hash key of the stones
     std::vector<Player> board_;
 };
 
@@ -4,16 +4,33 @@
 #include <algorithm>
 #include <bitset>
 #include <iostream>
+#include <random>
 #include <string>
 #include <vector>
 
 namespace minizero::env::othello {
 using namespace minizero::utils;
 
+uint64_t turn_hash_key;
+std::vector<GamePair<uint64_t>> grids_hash_key;
+
+void initialize()
+{
+    std::mt19937_64 generator;
+    generator.seed(0);
+    turn_hash_key = generator();
+    grids_hash_key.resize(kMaxOthelloBoardSize * kMaxOthelloBoardSize);
+    for (int pos = 0; pos < kMaxOthelloBoardSize * kMaxOthelloBoardSize; ++pos) {
+        grids_hash_key[pos].get(Player::kPlayer1) = generator();
+        grids_hash_key[pos].get(Player::kPlayer2) = generator();
+    }
+}
+
 void OthelloEnv::reset()
 {
     turn_ = Player::kPlayer1;
     actions_.clear();
+    undo_records_.clear();
     legal_pass_.set(false, false);
     board_.reset();
     legal_board_.reset();
@@ -33,6 +50,8 @@ void OthelloEnv::reset()
     legal_board_.get(turn_).set(init_place - board_size_ + 1, 1);
     legal_board_.get(turn_).set(init_place + board_size_ - 1, 1);
     legal_board_.get(turn_).set(init_place + 2 * board_size_, 1);
+    hash_key_ = 0;
+    for (int pos : {init_place, init_place + 1, init_place + board_size_, init_place + board_size_ + 1}) { hash_key_ ^= grids_hash_key[pos].get(board_.get(turn_)[pos] ? turn_ : getNextPlayer(turn_, kOthelloNumPlayer)); }
     // initial direction step size
     dir_step_[0] = board_size_;  // up
     dir_step_[1] = -board_size_; // down
@@ -108,6 +127,7 @@ bool OthelloEnv::act(const OthelloAction& action)
 
     if (!isLegalAction(action)) { return false; }
     actions_.push_back(action);
+    undo_records_.push_back({OthelloBitboard(), legal_pass_, legal_board_});
     turn_ = action.nextPlayer();
     if (isPassAction(action)) { return true; }
 
@@ -123,8 +143,11 @@ bool OthelloEnv::act(const OthelloAction& action)
         flip |= getFlipPoint(dir_step_[i], mask_[i], placed_pos, board_.get(getNextPlayer(player, kOthelloNumPlayer)), board_.get(player));
     }
 
+    undo_records_.back().flip_ = flip;
     board_.get(player) |= flip;
     board_.get(getNextPlayer(player, kOthelloNumPlayer)) &= ~flip;
+    hash_key_ ^= grids_hash_key[ID].get(player);
+    for (int pos = flip._Find_first(); pos < board_size_ * board_size_; pos = flip._Find_next(pos)) { hash_key_ ^= grids_hash_key[pos].get(Player::kPlayer1) ^ grids_hash_key[pos].get(Player::kPlayer2); }
 
     // update legal action bitboard
     empty_board = (one_board_ ^ (board_.get(Player::kPlayer1) | board_.get(Player::kPlayer2))); // places with no pieces
@@ -144,6 +167,29 @@ bool OthelloEnv::act(const std::vector<std::string>& action_string_args)
     return act(OthelloAction(action_string_args, board_size_));
 }
 
+bool OthelloEnv::undo()
+{
+    // flip the discs back and restore the legal boards, instead of recomputing them
+    if (actions_.empty()) { return false; }
+    const OthelloAction& action = actions_.back();
+    const OthelloUndoRecord& record = undo_records_.back();
+    if (!isPassAction(action)) {
+        Player player = action.getPlayer();
+        int ID = action.getActionID();
+        board_.get(player).set(ID, 0);
+        board_.get(player) &= ~record.flip_;
+        board_.get(getNextPlayer(player, kOthelloNumPlayer)) |= record.flip_;
+        hash_key_ ^= grids_hash_key[ID].get(player);
+        for (int pos = record.flip_._Find_first(); pos < board_size_ * board_size_; pos = record.flip_._Find_next(pos)) { hash_key_ ^= grids_hash_key[pos].get(Player::kPlayer1) ^ grids_hash_key[pos].get(Player::kPlayer2); }
+    }
+    legal_pass_ = record.legal_pass_;
+    legal_board_ = record.legal_board_;
+    turn_ = action.getPlayer();
+    actions_.pop_back();
+    undo_records_.pop_back();
+    return true;
+}
+
 std::string OthelloEnv::toString() const
 {
     std::ostringstream oss;
@@ -236,24 +282,33 @@ Player OthelloEnv::eval() const
 }
 std::vector<float> OthelloEnv::getFeatures(utils::Rotation rotation) const
 {
-    std::vector<float> vFeatures;
-    for (int channel = 0; channel < 4; ++channel) {
-        for (int pos = 0; pos < board_size_ * board_size_; ++pos) {
-            int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
-            if (channel == 0) {
-                vFeatures.push_back((board_.get(turn_)[rotation_pos] == 1 ? 1.0f : 0.0f));
-            } else if (channel == 1) {
-                vFeatures.push_back((board_.get(getNextPlayer(turn_, kOthelloNumPlayer))[rotation_pos] == 1 ? 1.0f : 0.0f));
-            } else if (channel == 2) {
-                vFeatures.push_back((turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
-            } else if (channel == 3) {
-                vFeatures.push_back((turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
-            }
-        }
-    }
+    std::vector<float> vFeatures(getNumInputChannels() * board_size_ * board_size_);
+    writeFeatures(vFeatures.data(), rotation);
     return vFeatures;
 }
 
+void OthelloEnv::writeFeatures(float* features, utils::Rotation rotation) const
+{
+    const int board_area = board_size_ * board_size_;
+    const std::vector<int>& rotation_table = utils::getRotationTable(rotation, board_size_);
+    std::fill(features, features + 2 * board_area, 0.0f);
+    for (int channel = 0; channel < 2; ++channel) {
+        // only visit the discs, the plane is filled with zeros
+        const OthelloBitboard& bitboard = board_.get(channel == 0 ? turn_ : getNextPlayer(turn_, kOthelloNumPlayer));
+        float* plane = features + channel * board_area;
+        for (int pos = bitboard._Find_first(); pos < board_area; pos = bitboard._Find_next(pos)) { plane[rotation_table[pos]] = 1.0f; }
+    }
+    std::fill(features + 2 * board_area, features + 3 * board_area, (turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
+    std::fill(features + 3 * board_area, features + 4 * board_area, (turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
+}
+
+uint64_t OthelloEnv::getTranspositionHashKey() const
+{
+    // the features only contain the discs and the turn, which also decide the legal actions
+    uint64_t key = hash_key_ ^ (turn_ == Player::kPlayer2 ? turn_hash_key : 0);
+    return (key == 0 ? 1 : key);
+}
+
 std::vector<float> OthelloEnv::getActionFeatures(const OthelloAction& action, utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
 {
     std::vector<float> action_features(board_size_ * board_size_, 0.0f);
@@ -15,8 +15,21 @@ const int kOthelloNumPlayer = 2;
 const int kMaxOthelloBoardSize = 16;
 typedef std::bitset<kMaxOthelloBoardSize * kMaxOthelloBoardSize> OthelloBitboard;
 
+extern uint64_t turn_hash_key;
+extern std::vector<GamePair<uint64_t>> grids_hash_key;
+
+void initialize();
+
 typedef BaseBoardAction<kOthelloNumPlayer> OthelloAction;
 
+// the state of a move taken back by OthelloEnv::undo(), the placed disc is the position of the action
+class OthelloUndoRecord {
+public:
+    OthelloBitboard flip_;                  // the flipped discs, empty for a pass
+    GamePair<bool> legal_pass_;             // before the move
+    GamePair<OthelloBitboard> legal_board_; // before the move
+};
+
 class OthelloEnv : public BaseBoardEnv<OthelloAction> {
 public:
     OthelloEnv()
@@ -28,13 +41,16 @@ public:
     void reset() override;
     bool act(const OthelloAction& action) override;
     bool act(const std::vector<std::string>& action_string_args) override;
+    bool undo() override;
     std::vector<OthelloAction> getLegalActions() const override;
     bool isLegalAction(const OthelloAction& action) const override;
     bool isTerminal() const override;
     float getReward() const override { return 0.0f; }
     float getEvalScore(bool is_resign = false) const override;
     std::vector<float> getFeatures(utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    void writeFeatures(float* features, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     std::vector<float> getActionFeatures(const OthelloAction& action, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    uint64_t getTranspositionHashKey() const override;
     inline int getNumInputChannels() const override { return 4; }
     inline int getPolicySize() const override { return getBoardSize() * getBoardSize() + 1; }
     std::string toString() const override;
@@ -68,6 +84,8 @@ private:
     GamePair<bool> legal_pass_;             // store black/white legal pass
     GamePair<OthelloBitboard> legal_board_; // store black/white legal board
     GamePair<OthelloBitboard> board_;       // store black/white board
+    uint64_t hash_key_;                     // the zobrist hash key of the discs
+    std::vector<OthelloUndoRecord> undo_records_;
 };
 
 class OthelloEnvLoader : public BaseBoardEnvLoader<OthelloAction, OthelloEnv> {
@@ -30,6 +30,15 @@ bool TicTacToeEnv::act(const std::vector<std::string>& action_string_args)
     return act(TicTacToeAction(action_string_args));
 }
 
+bool TicTacToeEnv::undo()
+{
+    if (actions_.empty()) { return false; }
+    board_[actions_.back().getActionID()] = Player::kPlayerNone;
+    turn_ = actions_.back().getPlayer();
+    actions_.pop_back();
+    return true;
+}
+
 std::vector<TicTacToeAction> TicTacToeEnv::getLegalActions() const
 {
     std::vector<TicTacToeAction> actions;
@@ -65,28 +74,40 @@ float TicTacToeEnv::getEvalScore(bool is_resign /*= false*/) const
 }
 
 std::vector<float> TicTacToeEnv::getFeatures(utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
+{
+    std::vector<float> vFeatures(getNumInputChannels() * board_size_ * board_size_);
+    writeFeatures(vFeatures.data(), rotation);
+    return vFeatures;
+}
+
+void TicTacToeEnv::writeFeatures(float* features, utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
 {
     /* 4 channels:
         0~1. own/opponent position
         2. Nought turn
         3. Cross turn
     */
-    std::vector<float> vFeatures;
-    for (int channel = 0; channel < 4; ++channel) {
-        for (int pos = 0; pos < kTicTacToeBoardSize * kTicTacToeBoardSize; ++pos) {
-            int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
-            if (channel == 0) {
-                vFeatures.push_back((board_[rotation_pos] == turn_ ? 1.0f : 0.0f));
-            } else if (channel == 1) {
-                vFeatures.push_back((board_[rotation_pos] == getNextPlayer(turn_, kTicTacToeNumPlayer) ? 1.0f : 0.0f));
-            } else if (channel == 2) {
-                vFeatures.push_back((turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
-            } else if (channel == 3) {
-                vFeatures.push_back((turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
-            }
+    const int board_area = board_size_ * board_size_;
+    const std::vector<int>& rotation_table = utils::getRotationTable(rotation, board_size_);
+    const Player opponent = getNextPlayer(turn_, kTicTacToeNumPlayer);
+    std::fill(features, features + 2 * board_area, 0.0f);
+    for (int pos = 0; pos < board_area; ++pos) {
+        if (board_[pos] == turn_) {
+            features[rotation_table[pos]] = 1.0f;
+        } else if (board_[pos] == opponent) {
+            features[board_area + rotation_table[pos]] = 1.0f;
         }
     }
-    return vFeatures;
+    std::fill(features + 2 * board_area, features + 3 * board_area, (turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
+    std::fill(features + 3 * board_area, features + 4 * board_area, (turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
+}
+
+uint64_t TicTacToeEnv::getTranspositionHashKey() const
+{
+    // the features only contain the board and the turn
+    uint64_t key = static_cast<int>(turn_);
+    for (const auto& player : board_) { key = key * 3 + static_cast<int>(player); }
+    return key;
 }
 
 std::vector<float> TicTacToeEnv::getActionFeatures(const TicTacToeAction& action, utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
@@ -19,13 +19,16 @@ public:
     void reset() override;
     bool act(const TicTacToeAction& action) override;
     bool act(const std::vector<std::string>& action_string_args) override;
+    bool undo() override;
     std::vector<TicTacToeAction> getLegalActions() const override;
     bool isLegalAction(const TicTacToeAction& action) const override;
     bool isTerminal() const override;
     float getReward() const override { return 0.0f; }
     float getEvalScore(bool is_resign = false) const override;
     std::vector<float> getFeatures(utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    void writeFeatures(float* features, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     std::vector<float> getActionFeatures(const TicTacToeAction& action, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    uint64_t getTranspositionHashKey() const override;
     inline int getNumInputChannels() const override { return 4; }
     inline int getPolicySize() const override { return getBoardSize() * getBoardSize(); }
     std::string toString() const override;
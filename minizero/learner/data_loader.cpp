@@ -73,62 +73,25 @@ float ReplayBuffer::getLossScale(const std::pair<int, int>& p)
     return std::pow((num_data_ * prob), (-config::learner_per_init_beta));
 }
 
-std::string DataLoaderSharedData::getNextEnvString()
-{
-    std::lock_guard<std::mutex> lock(mutex_);
-    std::string env_string = "";
-    if (!env_strings_.empty()) {
-        env_string = env_strings_.front();
-        env_strings_.pop_front();
-    }
-    return env_string;
-}
-
-int DataLoaderSharedData::getNextBatchIndex()
-{
-    std::lock_guard<std::mutex> lock(mutex_);
-    return (batch_index_ < config::learner_batch_size ? batch_index_++ : config::learner_batch_size);
-}
-
 void DataLoaderThread::initialize()
 {
     int seed = config::program_auto_seed ? std::random_device()() : config::program_seed + id_;
     Random::seed(seed);
 }
 
-void DataLoaderThread::runJob()
+void DataLoaderThread::addEnvironmentLoader(int env_index)
 {
-    if (!getSharedData()->env_strings_.empty()) {
-        while (addEnvironmentLoader()) {}
-    } else {
-        while (sampleData()) {}
-    }
-}
-
-bool DataLoaderThread::addEnvironmentLoader()
-{
-    std::string env_string = getSharedData()->getNextEnvString();
-    if (env_string.empty()) { return false; }
-
     EnvironmentLoader env_loader;
-    if (env_loader.loadFromString(env_string)) { getSharedData()->replay_buffer_.addData(env_loader); }
-    return true;
+    if (env_loader.loadFromString(getSharedData()->env_strings_[env_index])) { getSharedData()->replay_buffer_.addData(env_loader); }
 }
 
-bool DataLoaderThread::sampleData()
+void DataLoaderThread::sampleData(int batch_index)
 {
-    int batch_index = getSharedData()->getNextBatchIndex();
-    if (batch_index >= config::learner_batch_size) { return false; }
-
     if (config::nn_type_name == "alphazero") {
         setAlphaZeroTrainingData(batch_index);
     } else if (config::nn_type_name == "muzero") {
         setMuZeroTrainingData(batch_index);
-    } else {
-        return false; // should not be here
     }
-
-    return true;
 }
 
 void DataLoaderThread::setAlphaZeroTrainingData(int batch_index)
@@ -209,7 +172,11 @@ DataLoader::DataLoader(const std::string& conf_file_name)
 
 void DataLoader::initialize()
 {
-    createSlaveThreads(config::learner_num_thread);
+    // the calling thread (e.g., the python trainer) also runs the jobs, as the last thread of the pool
+    const int num_threads = std::max(1, config::learner_num_thread);
+    createSharedData();
+    for (int id = 0; id <= num_threads; ++id) { threads_.emplace_back(newThread(id)); }
+    thread_pool_ = std::make_unique<utils::ThreadPool>(num_threads, utils::getThreadCPUs(config::program_thread_affinity, num_threads), [this](int id) { threads_[id]->initialize(); });
     getSharedData()->createDataPtr();
 }
 
@@ -218,16 +185,14 @@ void DataLoader::loadDataFromFile(const std::string& file_name)
     std::ifstream fin(file_name, std::ifstream::in);
     for (std::string content; std::getline(fin, content);) { getSharedData()->env_strings_.push_back(content); }
 
-    for (auto& t : slave_threads_) { t->start(); }
-    for (auto& t : slave_threads_) { t->finish(); }
+    thread_pool_->parallelFor(0, getSharedData()->env_strings_.size(), 1, [this](int env_index, int thread_id) { threads_[thread_id]->addEnvironmentLoader(env_index); });
+    getSharedData()->env_strings_.clear();
     getSharedData()->replay_buffer_.game_priority_sum_ = std::accumulate(getSharedData()->replay_buffer_.game_priorities_.begin(), getSharedData()->replay_buffer_.game_priorities_.end(), 0.0f);
 }
 
 void DataLoader::sampleData()
 {
-    getSharedData()->batch_index_ = 0;
-    for (auto& t : slave_threads_) { t->start(); }
-    for (auto& t : slave_threads_) { t->finish(); }
+    thread_pool_->parallelFor(0, config::learner_batch_size, 0, [this](int batch_index, int thread_id) { threads_[thread_id]->sampleData(batch_index); });
 }
 
 void DataLoader::updatePriority(int* sampled_index, float* batch_values)
@@ -245,10 +210,11 @@ void DataLoader::updatePriority(int* sampled_index, float* batch_values)
         getSharedData()->replay_buffer_.position_priorities_[env_id][pos_id] = std::pow(env_loader.getPriority(pos_id), config::learner_per_alpha);
     }
 
-    // recalculate priority to correct floating number error (TODO: speedup this)
-    for (size_t i = 0; i < getSharedData()->replay_buffer_.game_priorities_.size(); ++i) {
-        getSharedData()->replay_buffer_.game_priorities_[i] = std::accumulate(getSharedData()->replay_buffer_.position_priorities_[i].begin(), getSharedData()->replay_buffer_.position_priorities_[i].end(), 0.0f);
-    }
+    // recalculate priority to correct floating number error
+    ReplayBuffer& replay_buffer = getSharedData()->replay_buffer_;
+    thread_pool_->parallelFor(0, replay_buffer.game_priorities_.size(), 0, [&replay_buffer](int i, int) {
+        replay_buffer.game_priorities_[i] = std::accumulate(replay_buffer.position_priorities_[i].begin(), replay_buffer.position_priorities_[i].end(), 0.0f);
+    });
     getSharedData()->replay_buffer_.game_priority_sum_ = std::accumulate(getSharedData()->replay_buffer_.game_priorities_.begin(), getSharedData()->replay_buffer_.game_priorities_.end(), 0.0f);
 }
 
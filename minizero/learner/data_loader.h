@@ -50,51 +50,54 @@ public:
 
 class DataLoaderSharedData : public utils::BaseSharedData {
 public:
-    std::string getNextEnvString();
-    int getNextBatchIndex();
-
     virtual void createDataPtr() { data_ptr_ = std::make_shared<BatchDataPtr>(); }
     inline std::shared_ptr<BatchDataPtr> getDataPtr() { return std::static_pointer_cast<BatchDataPtr>(data_ptr_); }
 
-    int batch_index_;
     ReplayBuffer replay_buffer_;
-    std::mutex mutex_;
-    std::deque<std::string> env_strings_;
+    std::vector<std::string> env_strings_;
     std::shared_ptr<BaseBatchDataPtr> data_ptr_;
 };
 
-class DataLoaderThread : public utils::BaseSlaveThread {
+// the jobs run by a thread of the thread pool of DataLoader, or by the thread calling DataLoader
+class DataLoaderThread {
 public:
-    DataLoaderThread(int id, std::shared_ptr<utils::BaseSharedData> shared_data)
-        : BaseSlaveThread(id, shared_data) {}
+    DataLoaderThread(int id, std::shared_ptr<DataLoaderSharedData> shared_data)
+        : id_(id),
+          shared_data_(shared_data) {}
+    virtual ~DataLoaderThread() = default;
 
-    void initialize() override;
-    void runJob() override;
-    bool isDone() override { return false; }
+    virtual void initialize(); // called on the thread running the jobs before its first job
+    virtual void addEnvironmentLoader(int env_index);
+    virtual void sampleData(int batch_index);
 
 protected:
-    virtual bool addEnvironmentLoader();
-    virtual bool sampleData();
-
     virtual void setAlphaZeroTrainingData(int batch_index);
     virtual void setMuZeroTrainingData(int batch_index);
 
-    inline std::shared_ptr<DataLoaderSharedData> getSharedData() { return std::static_pointer_cast<DataLoaderSharedData>(shared_data_); }
+    inline std::shared_ptr<DataLoaderSharedData> getSharedData() { return shared_data_; }
+
+    int id_;
+    std::shared_ptr<DataLoaderSharedData> shared_data_;
 };
 
-class DataLoader : public utils::BaseParalleler {
+class DataLoader {
 public:
     DataLoader(const std::string& conf_file_name);
+    virtual ~DataLoader() = default;
 
-    void initialize() override;
-    void summarize() override {}
+    virtual void initialize();
     virtual void loadDataFromFile(const std::string& file_name);
     virtual void sampleData();
     virtual void updatePriority(int* sampled_index, float* batch_values);
 
-    void createSharedData() override { shared_data_ = std::make_shared<DataLoaderSharedData>(); }
-    std::shared_ptr<utils::BaseSlaveThread> newSlaveThread(int id) override { return std::make_shared<DataLoaderThread>(id, shared_data_); }
-    inline std::shared_ptr<DataLoaderSharedData> getSharedData() { return std::static_pointer_cast<DataLoaderSharedData>(shared_data_); }
+    virtual void createSharedData() { shared_data_ = std::make_shared<DataLoaderSharedData>(); }
+    virtual std::shared_ptr<DataLoaderThread> newThread(int id) { return std::make_shared<DataLoaderThread>(id, shared_data_); }
+    inline std::shared_ptr<DataLoaderSharedData> getSharedData() { return shared_data_; }
+
+protected:
+    std::shared_ptr<DataLoaderSharedData> shared_data_;
+    std::vector<std::shared_ptr<DataLoaderThread>> threads_; // the jobs of each pool thread, and the last one for the calling thread
+    std::unique_ptr<utils::ThreadPool> thread_pool_;
 };
 
 } // namespace minizero::learner
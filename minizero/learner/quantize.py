@@ -0,0 +1,59 @@
+#!/usr/bin/env python
+
+import sys
+import torch
+import torch.nn as nn
+from minizero.network.py.create_network import create_network
+
+
+def eprint(*args, **kwargs):
+    print(*args, file=sys.stderr, **kwargs, flush=True)
+
+
+def load_network(model_file):
+    network = create_network(py.get_game_name(),
+                             py.get_nn_num_input_channels(),
+                             py.get_nn_input_channel_height(),
+                             py.get_nn_input_channel_width(),
+                             py.get_nn_num_hidden_channels(),
+                             py.get_nn_hidden_channel_height(),
+                             py.get_nn_hidden_channel_width(),
+                             py.get_nn_num_action_feature_channels(),
+                             py.get_nn_num_blocks(),
+                             py.get_nn_action_size(),
+                             py.get_nn_num_value_hidden_channels(),
+                             py.get_nn_discrete_value_size(),
+                             py.get_nn_type_name())
+    snapshot = torch.load(model_file, map_location=torch.device('cpu'))
+    network.load_state_dict(snapshot['network'])
+    network.eval()
+    return network
+
+
+def quantize_int8(network):
+    # dynamic quantization: the weights of the fully connected layers are stored in int8 and the activations are quantized on the fly
+    # only the linear layers of the heads are quantized, the convolutions of the residual trunk (most of the computation) stay in fp32,
+    # and nn_cpu_precision=bf16 does not apply to the quantized model, so int8 barely speeds up the networks dominated by the trunk
+    # the quantized model only runs on CPUs
+    torch.backends.quantized.engine = 'fbgemm' if 'fbgemm' in torch.backends.quantized.supported_engines else 'qnnpack'
+    return torch.ao.quantization.quantize_dynamic(network, {nn.Linear}, dtype=torch.qint8)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) == 4:
+        game_type = sys.argv[1]
+        conf_file_name = sys.argv[2]
+        model_file = sys.argv[3]
+
+        # import pybind library
+        _temps = __import__(f'build.{game_type}', globals(), locals(), ['minizero_py'], 0)
+        py = _temps.minizero_py
+    else:
+        eprint("python quantize.py game_type conf_file model_file(*.pkl)")
+        exit(0)
+
+    py.load_config_file(conf_file_name)
+    network = quantize_int8(load_network(model_file))
+    output_file = model_file[:-len(".pkl")] + "_int8.pt" if model_file.endswith(".pkl") else model_file + "_int8.pt"
+    torch.jit.script(network).save(output_file)
+    eprint(f"Saved the int8 model to {output_file}")
@@ -1,11 +1,16 @@
 #pragma once
 
 #include "network.h"
+#include "profiler.h"
 #include "utils.h"
 #include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <memory>
-#include <mutex>
+#include <numeric>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace minizero::network {
@@ -13,14 +18,23 @@ namespace minizero::network {
 class AlphaZeroNetworkOutput : public NetworkOutput {
 public:
     float value_;
-    std::vector<float> policy_;
-    std::vector<float> policy_logits_;
+    OutputRow policy_;
+    OutputRow policy_logits_;
 
-    AlphaZeroNetworkOutput(int policy_size)
+    AlphaZeroNetworkOutput() { value_ = 0.0f; }
+
+    std::shared_ptr<AlphaZeroNetworkOutput> clone() const
     {
-        value_ = 0.0f;
-        policy_.resize(policy_size, 0.0f);
-        policy_logits_.resize(policy_size, 0.0f);
+        // a copy owning its rows, e.g., for keeping the output in a table without keeping the outputs of its whole batch
+        auto batch = std::make_shared<BatchOutput<AlphaZeroNetworkOutput>>(1, 2 * policy_.size());
+        float* row = batch->getRow(0);
+        std::copy(policy_.begin(), policy_.end(), row);
+        std::copy(policy_logits_.begin(), policy_logits_.end(), row + policy_.size());
+        AlphaZeroNetworkOutput& output = batch->outputs_[0];
+        output.value_ = value_;
+        output.policy_ = OutputRow(row, policy_.size());
+        output.policy_logits_ = OutputRow(row + policy_.size(), policy_logits_.size());
+        return std::shared_ptr<AlphaZeroNetworkOutput>(batch, &output);
     }
 };
 
@@ -28,14 +42,23 @@ class AlphaZeroNetwork : public Network {
 public:
     AlphaZeroNetwork()
     {
-        clear();
+        batch_size_ = 0;
+        num_symmetries_ = 0;
+        is_deduplicating_batch_ = false;
+        resetDeduplicationStatistics();
     }
 
     void loadModel(const std::string& nn_file_name, const int gpu_id) override
     {
         assert(batch_size_ == 0); // should avoid loading model when batch size is not 0
         Network::loadModel(nn_file_name, gpu_id);
-        clear();
+        tensor_input_.reset({getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth()}, getDevice().is_cuda());
+    }
+
+    void reserveBatchSize(int max_batch_size) override
+    {
+        assert(batch_size_ == 0);
+        tensor_input_.reserve(max_batch_size);
     }
 
     std::string toString() const override
@@ -48,76 +71,212 @@ public:
     int pushBack(std::vector<float> features)
     {
         assert(static_cast<int>(features.size()) == getNumInputChannels() * getInputChannelHeight() * getInputChannelWidth());
-        assert(batch_size_ < kReserved_batch_size);
+        std::pair<int, float*> input = allocateInput();
+        std::copy(features.begin(), features.end(), input.second);
+        return input.first;
+    }
+
+    void setSymmetries(const std::vector<std::vector<int>>& position_tables, const std::vector<std::vector<int>>& action_tables)
+    {
+        // evaluate each input in all the given symmetries in one forward, and average the outputs mapped back to the input position, e.g., for evaluation and analysis
+        // position_tables[i][pos] is the position of pos in the i-th symmetry (Environment::getRotatePosition), action_tables[i][action_id] is the action of action_id in it (Environment::getRotateAction)
+        // the symmetric inputs are built on the device from the uploaded input, so the features are written once, without rotation
+        assert(position_tables.size() == action_tables.size());
+        num_symmetries_ = position_tables.size();
+        if (num_symmetries_ == 0) { return; }
 
-        int index;
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            index = batch_size_++;
-            tensor_input_.resize(batch_size_);
+        assert(getInputChannelHeight() == getInputChannelWidth());
+        const int board_area = getInputChannelHeight() * getInputChannelWidth();
+        std::vector<int64_t> feature_indices(num_symmetries_ * board_area), action_indices(num_symmetries_ * getActionSize());
+        for (int i = 0; i < num_symmetries_; ++i) {
+            assert(static_cast<int>(position_tables[i].size()) == board_area && static_cast<int>(action_tables[i].size()) == getActionSize());
+            for (int pos = 0; pos < board_area; ++pos) { feature_indices[i * board_area + position_tables[i][pos]] = pos; } // the feature at position_tables[i][pos] in the i-th symmetry is at pos in the input
+            for (int action_id = 0; action_id < getActionSize(); ++action_id) { action_indices[i * getActionSize() + action_id] = action_tables[i][action_id]; }
         }
-        tensor_input_[index] = torch::from_blob(features.data(), {1, getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth()}).clone();
-        return index;
+        symmetry_feature_indices_ = torch::tensor(feature_indices).view({num_symmetries_, board_area}).to(getDevice());
+        symmetry_action_indices_ = torch::tensor(action_indices).view({num_symmetries_, getActionSize()}).to(getDevice());
     }
 
-    std::vector<std::shared_ptr<NetworkOutput>> forward()
+    std::pair<int, float*> allocateInput(NetworkModel* model = nullptr)
     {
-        assert(batch_size_ > 0);
-        auto forward_result = network_.forward(std::vector<torch::jit::IValue>{torch::cat(tensor_input_).to(getDevice())}).toGenericDict();
+        // return the batch index and the address to write its features to, e.g., by BaseEnv::writeFeatures, which avoids building and cloning a feature vector
+        // the input is evaluated by the given model, e.g., the model an actor started its search with, or by the latest model if not given
+        int index = batch_size_++;
+        return {index, tensor_input_.getEntry(index, model)};
+    }
 
-        auto policy_output = forward_result.at("policy").toTensor().to(at::kCPU);
-        auto policy_logits_output = forward_result.at("policy_logit").toTensor().to(at::kCPU);
-        auto value_output = forward_result.at("value").toTensor().to(at::kCPU);
-        assert(policy_output.numel() == batch_size_ * getActionSize());
-        assert(policy_logits_output.numel() == batch_size_ * getActionSize());
-        assert(value_output.numel() == batch_size_ * getDiscreteValueSize());
+    std::vector<std::shared_ptr<NetworkOutput>> forward()
+    {
+        const int batch_size = batch_size_;
+        assert(batch_size > 0);
+        utils::Profiler::addBatchSize(batch_size);
+        utils::ProfileTimer timer(utils::ProfilePhase::kTensor);
+        std::shared_ptr<NetworkModel> latest_model = getModel(); // kept until the forward is done
+        std::vector<std::pair<NetworkModel*, std::vector<int64_t>>> model_rows = groupInputsByModel(tensor_input_.getModels(batch_size), latest_model.get());
+        torch::Tensor batch = tensor_input_.getBatch(batch_size);
+        std::vector<int> unique_ids; // the row of each input in the deduplicated batch, empty if no input is duplicated
+        if (is_deduplicating_batch_ && model_rows.size() == 1) { batch = deduplicateBatch(batch, unique_ids); }
+        const int num_inputs = batch.size(0);
 
+        // each row of the batch output is [policy, policy logits, value]
         const int policy_size = getActionSize();
-        std::vector<std::shared_ptr<NetworkOutput>> network_outputs;
-        for (int i = 0; i < batch_size_; ++i) {
-            network_outputs.emplace_back(std::make_shared<AlphaZeroNetworkOutput>(policy_size));
-            auto alphazero_network_output = std::static_pointer_cast<AlphaZeroNetworkOutput>(network_outputs.back());
+        const int value_size = getDiscreteValueSize();
+        auto batch_output = std::make_shared<BatchOutput<AlphaZeroNetworkOutput>>(num_inputs, 2 * policy_size + value_size);
+        for (auto& [model, rows] : model_rows) {
+            if (rows.empty()) {
+                batch_output->getTensor().copy_(forwardModel(*model, batch, timer));
+            } else {
+                // the batch mixes the inputs of the searches started before and after another model is loaded
+                torch::Tensor row_indices = torch::tensor(rows);
+                batch_output->getTensor().index_copy_(0, row_indices, forwardModel(*model, batch.index_select(0, row_indices), timer).to(torch::kCPU, torch::kFloat32));
+            }
+        }
+
+        for (int i = 0; i < num_inputs; ++i) {
+            AlphaZeroNetworkOutput& alphazero_network_output = batch_output->outputs_[i];
+            const float* row = batch_output->getRow(i);
 
             // policy & policy logits
-            std::copy(policy_output.data_ptr<float>() + i * policy_size,
-                      policy_output.data_ptr<float>() + (i + 1) * policy_size,
-                      alphazero_network_output->policy_.begin());
-            std::copy(policy_logits_output.data_ptr<float>() + i * policy_size,
-                      policy_logits_output.data_ptr<float>() + (i + 1) * policy_size,
-                      alphazero_network_output->policy_logits_.begin());
+            alphazero_network_output.policy_ = OutputRow(row, policy_size);
+            alphazero_network_output.policy_logits_ = OutputRow(row + policy_size, policy_size);
 
             // value
-            if (getDiscreteValueSize() == 1) {
-                alphazero_network_output->value_ = value_output[i].item<float>();
+            const float* value_row = row + 2 * policy_size;
+            if (value_size == 1) {
+                alphazero_network_output.value_ = value_row[0];
             } else {
-                int start_value = -getDiscreteValueSize() / 2;
-                alphazero_network_output->value_ = std::accumulate(value_output.data_ptr<float>() + i * getDiscreteValueSize(),
-                                                                   value_output.data_ptr<float>() + (i + 1) * getDiscreteValueSize(),
-                                                                   0.0f,
-                                                                   [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
-                alphazero_network_output->value_ = utils::invertValue(alphazero_network_output->value_);
+                int start_value = -value_size / 2;
+                alphazero_network_output.value_ = std::accumulate(value_row, value_row + value_size, 0.0f, [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
+                alphazero_network_output.value_ = utils::invertValue(alphazero_network_output.value_);
             }
         }
+        std::vector<std::shared_ptr<NetworkOutput>> network_outputs = BatchOutput<AlphaZeroNetworkOutput>::share(batch_output);
+
+        tensor_input_.clear(batch_size);
+        batch_size_ = 0;
+        if (unique_ids.empty()) { return network_outputs; }
 
-        clear();
-        return network_outputs;
+        // the identical inputs share the output of their first occurrence
+        std::vector<std::shared_ptr<NetworkOutput>> batch_outputs(batch_size);
+        for (int i = 0; i < batch_size; ++i) { batch_outputs[i] = network_outputs[unique_ids[i]]; }
+        return batch_outputs;
     }
 
     inline int getBatchSize() const { return batch_size_; }
+    inline void setDeduplicatingBatch(bool is_deduplicating_batch) { is_deduplicating_batch_ = is_deduplicating_batch; }
+    inline int64_t getNumDeduplicatedBatches() const { return num_deduplicated_batches_; }
+    inline int64_t getNumDeduplicatedInputs() const { return num_deduplicated_inputs_; }
+    inline int64_t getNumUniqueInputs() const { return num_unique_inputs_; }
+    inline void resetDeduplicationStatistics() { num_deduplicated_batches_ = num_deduplicated_inputs_ = num_unique_inputs_ = 0; }
 
 protected:
-    inline void clear()
+    torch::Tensor forwardModel(NetworkModel& model, const torch::Tensor& batch, utils::ProfileTimer& timer)
     {
-        batch_size_ = 0;
-        tensor_input_.clear();
-        tensor_input_.reserve(kReserved_batch_size);
+        // return the [batch, policy + policy logits + value] outputs of the model, still on the device
+        timer.next(utils::ProfilePhase::kTensor);
+        const int num_inputs = batch.size(0);
+        torch::Tensor input = toInputTensor(batch, model);
+        if (num_symmetries_ > 0) { input = getSymmetryInputs(input); }
+        timer.next(utils::ProfilePhase::kForward);
+        auto forward_result = model.module_.forward(std::vector<torch::jit::IValue>{input}).toGenericDict();
+
+        auto policy_output = forward_result.at("policy").toTensor();
+        auto policy_logits_output = forward_result.at("policy_logit").toTensor();
+        auto value_output = forward_result.at("value").toTensor();
+        if (num_symmetries_ > 0) {
+            policy_output = averageSymmetryOutputs(policy_output, num_inputs, true);
+            policy_logits_output = averageSymmetryOutputs(policy_logits_output, num_inputs, true);
+            value_output = averageSymmetryOutputs(value_output, num_inputs, false);
+        }
+        assert(policy_output.numel() == num_inputs * getActionSize());
+        assert(policy_logits_output.numel() == num_inputs * getActionSize());
+        assert(value_output.numel() == num_inputs * getDiscreteValueSize());
+
+        // a GPU forward runs asynchronously, so the time waiting for it is counted in decode when the outputs are copied
+        timer.next(utils::ProfilePhase::kDecode);
+        return torch::cat({policy_output.reshape({num_inputs, -1}), policy_logits_output.reshape({num_inputs, -1}), value_output.reshape({num_inputs, -1})}, 1);
+    }
+
+    torch::Tensor deduplicateBatch(const torch::Tensor& batch, std::vector<int>& unique_ids)
+    {
+        // evaluate the identical inputs once, e.g., the initial positions of all actors after reset_actors
+        // the inputs are grouped by the hash of their features, and compared with the first input of the same hash to rule out collisions
+        const int batch_size = batch.size(0);
+        const int64_t entry_size = batch.numel() / batch_size;
+        const float* data = batch.data_ptr<float>();
+        std::vector<int64_t> unique_rows;
+        std::unordered_map<uint64_t, int> hash_ids; // hash -> the row of its first input in the deduplicated batch
+        unique_ids.resize(batch_size);
+        for (int i = 0; i < batch_size; ++i) {
+            const float* entry = data + i * entry_size;
+            uint64_t hash = getFeatureHash(entry, entry_size);
+            auto it = hash_ids.find(hash);
+            if (it != hash_ids.end() && std::memcmp(data + unique_rows[it->second] * entry_size, entry, entry_size * sizeof(float)) == 0) {
+                unique_ids[i] = it->second;
+                continue;
+            }
+            if (it == hash_ids.end()) { hash_ids[hash] = unique_rows.size(); }
+            unique_ids[i] = unique_rows.size();
+            unique_rows.push_back(i);
+        }
+
+        ++num_deduplicated_batches_;
+        num_deduplicated_inputs_ += batch_size;
+        num_unique_inputs_ += unique_rows.size();
+        if (static_cast<int>(unique_rows.size()) == batch_size) {
+            unique_ids.clear();
+            return batch;
+        }
+        return batch.index_select(0, torch::tensor(unique_rows));
     }
 
-    int batch_size_;
-    std::mutex mutex_;
-    std::vector<torch::Tensor> tensor_input_;
+    static inline uint64_t getFeatureHash(const float* features, int64_t size)
+    {
+        // mix the features 64 bits at a time, the features are mostly 0 and 1, so any difference changes some words
+        uint64_t hash = 0x9E3779B97F4A7C15ULL ^ size;
+        int64_t i = 0;
+        for (; i + 2 <= size; i += 2) {
+            uint64_t word;
+            std::memcpy(&word, features + i, sizeof(word));
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+            hash ^= hash >> 32;
+        }
+        if (i < size) {
+            uint32_t word;
+            std::memcpy(&word, features + i, sizeof(word));
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        }
+        return hash ^ (hash >> 29);
+    }
+
+    torch::Tensor getSymmetryInputs(const torch::Tensor& input) const
+    {
+        // [batch, channel, height, width] -> [num_symmetries * batch, channel, height, width], the i-th batch is in the i-th symmetry
+        torch::Tensor features = input.flatten(2);
+        std::vector<torch::Tensor> inputs;
+        for (int i = 0; i < num_symmetries_; ++i) { inputs.push_back(features.index_select(2, symmetry_feature_indices_[i])); }
+        return torch::cat(inputs).view({-1, input.size(1), input.size(2), input.size(3)});
+    }
+
+    torch::Tensor averageSymmetryOutputs(const torch::Tensor& output, int batch_size, bool is_action_output) const
+    {
+        // [num_symmetries * batch, size] -> [batch, size], the action outputs of the i-th symmetry are mapped back by the action table of the i-th symmetry
+        torch::Tensor outputs = output.reshape({num_symmetries_, batch_size, -1});
+        if (!is_action_output) { return outputs.mean(0); }
+        std::vector<torch::Tensor> action_outputs;
+        for (int i = 0; i < num_symmetries_; ++i) { action_outputs.push_back(outputs[i].index_select(1, symmetry_action_indices_[i])); }
+        return torch::stack(action_outputs).mean(0);
+    }
 
-    const int kReserved_batch_size = 4096;
+    std::atomic<int> batch_size_;
+    BatchInputBuffer tensor_input_;
+    bool is_deduplicating_batch_;
+    std::atomic<int64_t> num_deduplicated_batches_;
+    std::atomic<int64_t> num_deduplicated_inputs_;
+    std::atomic<int64_t> num_unique_inputs_;
+    int num_symmetries_; // 0 for evaluating each input once
+    torch::Tensor symmetry_feature_indices_;
+    torch::Tensor symmetry_action_indices_;
 };
 
 } // namespace minizero::network
@@ -0,0 +1,115 @@
+#include "inference_service.h"
+#include <algorithm>
+#include <utility>
+
+namespace minizero::network {
+
+InferenceService::InferenceService(const std::shared_ptr<AlphaZeroNetwork>& network, int max_batch_size, int timeout_us, CompletionCallback on_complete)
+    : network_(network),
+      max_batch_size_(std::max(1, max_batch_size)),
+      timeout_(std::max(0, timeout_us)),
+      on_complete_(on_complete),
+      num_queued_requests_(0),
+      is_waiting_(false),
+      is_stopped_(true)
+{
+    resetStatistics();
+}
+
+void InferenceService::start()
+{
+    if (!is_stopped_) { return; }
+    is_stopped_ = false;
+    thread_ = std::thread(&InferenceService::run, this);
+}
+
+void InferenceService::stop()
+{
+    if (is_stopped_) { return; }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_stopped_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void InferenceService::submit(InferenceRequest* request)
+{
+    queue_.push(request);
+    ++num_queued_requests_;
+
+    // only wake the service thread when it sleeps, the check after the increment cannot miss a thread that is going to sleep
+    if (is_waiting_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_one();
+    }
+}
+
+void InferenceService::resetStatistics()
+{
+    num_batches_ = 0;
+    num_evaluated_requests_ = 0;
+    busy_time_ = 0;
+}
+
+void InferenceService::run()
+{
+    std::vector<InferenceRequest*> batch;
+    batch.reserve(max_batch_size_);
+    while (!is_stopped_) {
+        // wait for the first request, then collect requests until the batch is full or the deadline passes
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+        while (static_cast<int>(batch.size()) < max_batch_size_ && !is_stopped_) {
+            InferenceRequest* request = (num_queued_requests_ > 0 ? queue_.pop() : nullptr);
+            if (request) {
+                --num_queued_requests_;
+                if (batch.empty()) { deadline = std::chrono::steady_clock::now() + timeout_; }
+                batch.push_back(request);
+            } else if (!waitForRequests(deadline)) {
+                break;
+            }
+        }
+        if (batch.empty()) { continue; }
+
+        evaluate(batch);
+        batch.clear();
+    }
+}
+
+bool InferenceService::waitForRequests(const std::chrono::steady_clock::time_point& deadline)
+{
+    // return false if the deadline passes without new requests
+    if (num_queued_requests_ > 0) { return true; }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto can_wake = [this] { return num_queued_requests_ > 0 || is_stopped_; };
+    is_waiting_ = true;
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+        cv_.wait(lock, can_wake);
+    } else {
+        cv_.wait_until(lock, deadline, can_wake);
+    }
+    is_waiting_ = false;
+    return num_queued_requests_ > 0 && !is_stopped_;
+}
+
+void InferenceService::evaluate(const std::vector<InferenceRequest*>& batch)
+{
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    for (InferenceRequest* request : batch) {
+        std::pair<int, float*> input = network_->allocateInput(request->model_);
+        std::copy(request->features_.begin(), request->features_.end(), input.second);
+    }
+    std::vector<std::shared_ptr<NetworkOutput>> outputs = network_->forward();
+    busy_time_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+    ++num_batches_;
+    num_evaluated_requests_ += batch.size();
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i]->output_ = outputs[i];
+        on_complete_(batch[i]);
+    }
+}
+
+} // namespace minizero::network
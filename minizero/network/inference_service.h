@@ -0,0 +1,73 @@
+#pragma once
+
+#include "alphazero_network.h"
+#include "mpsc_queue.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace minizero::network {
+
+// a completion slot, the submitter writes the features and gets the output back in the completion callback
+class InferenceRequest : public utils::MPSCQueueNode {
+public:
+    InferenceRequest(int id, int feature_size)
+        : id_(id),
+          features_(feature_size),
+          model_(nullptr) {}
+
+    int id_; // e.g., the actor id
+    std::vector<float> features_;
+    NetworkModel* model_; // the model evaluating the features, nullptr for the latest model
+    std::shared_ptr<NetworkOutput> output_;
+};
+
+// evaluates the requests of an AlphaZero network on a dedicated thread, any thread can submit requests without locks
+// a batch is evaluated when it reaches the maximum batch size or its first request has waited longer than the timeout
+class InferenceService {
+public:
+    using CompletionCallback = std::function<void(InferenceRequest*)>;
+
+    InferenceService(const std::shared_ptr<AlphaZeroNetwork>& network, int max_batch_size, int timeout_us, CompletionCallback on_complete);
+    ~InferenceService() { stop(); }
+
+    void start();
+    void stop();
+    void submit(InferenceRequest* request);
+    void resetStatistics();
+
+    inline std::shared_ptr<AlphaZeroNetwork> getNetwork() const { return network_; }
+    inline int64_t getNumBatches() const { return num_batches_; }
+    inline int64_t getNumRequests() const { return num_evaluated_requests_; }
+    inline int64_t getBusyTime() const { return busy_time_; } // in microseconds
+
+protected:
+    void run();
+    bool waitForRequests(const std::chrono::steady_clock::time_point& deadline);
+    void evaluate(const std::vector<InferenceRequest*>& batch);
+
+    std::shared_ptr<AlphaZeroNetwork> network_;
+    int max_batch_size_;
+    std::chrono::microseconds timeout_;
+    CompletionCallback on_complete_;
+
+    utils::MPSCQueue<InferenceRequest> queue_;
+    std::atomic<int> num_queued_requests_;
+    std::atomic<bool> is_waiting_;
+    std::atomic<bool> is_stopped_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+
+    std::atomic<int64_t> num_batches_;
+    std::atomic<int64_t> num_evaluated_requests_;
+    std::atomic<int64_t> busy_time_;
+};
+
+} // namespace minizero::network
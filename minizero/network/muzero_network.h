@@ -1,10 +1,12 @@
 #pragma once
 
 #include "network.h"
+#include "profiler.h"
 #include "utils.h"
 #include <algorithm>
+#include <atomic>
 #include <memory>
-#include <mutex>
+#include <numeric>
 #include <string>
 #include <utility>
 #include <vector>
@@ -15,17 +17,14 @@ class MuZeroNetworkOutput : public NetworkOutput {
 public:
     float value_;
     float reward_;
-    std::vector<float> policy_;
-    std::vector<float> policy_logits_;
-    std::vector<float> hidden_state_;
+    OutputRow policy_;
+    OutputRow policy_logits_;
+    OutputRow hidden_state_;
 
-    MuZeroNetworkOutput(int policy_size, int hidden_state_size)
+    MuZeroNetworkOutput()
     {
         value_ = 0.0f;
         reward_ = 0.0f;
-        policy_.resize(policy_size, 0.0f);
-        policy_logits_.resize(policy_size, 0.0f);
-        hidden_state_.resize(hidden_state_size, 0.0f);
     }
 };
 
@@ -35,12 +34,6 @@ public:
     {
         num_action_feature_channels_ = -1;
         initial_input_batch_size_ = recurrent_input_batch_size_ = 0;
-        initial_tensor_input_.clear();
-        initial_tensor_input_.reserve(kReserved_batch_size);
-        recurrent_tensor_feature_input_.clear();
-        recurrent_tensor_feature_input_.reserve(kReserved_batch_size);
-        recurrent_tensor_action_input_.clear();
-        recurrent_tensor_action_input_.reserve(kReserved_batch_size);
     }
 
     void loadModel(const std::string& nn_file_name, const int gpu_id) override
@@ -48,9 +41,20 @@ public:
         Network::loadModel(nn_file_name, gpu_id);
 
         std::vector<torch::jit::IValue> dummy;
-        num_action_feature_channels_ = network_.get_method("get_num_action_feature_channels")(dummy).toInt();
+        num_action_feature_channels_ = getModel()->module_.get_method("get_num_action_feature_channels")(dummy).toInt();
         initial_input_batch_size_ = 0;
         recurrent_input_batch_size_ = 0;
+        initial_tensor_input_.reset({getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth()}, getDevice().is_cuda());
+        recurrent_tensor_feature_input_.reset({getNumHiddenChannels(), getHiddenChannelHeight(), getHiddenChannelWidth()}, getDevice().is_cuda());
+        recurrent_tensor_action_input_.reset({getNumActionFeatureChannels(), getHiddenChannelHeight(), getHiddenChannelWidth()}, getDevice().is_cuda());
+    }
+
+    void reserveBatchSize(int max_batch_size) override
+    {
+        assert(initial_input_batch_size_ == 0 && recurrent_input_batch_size_ == 0);
+        initial_tensor_input_.reserve(max_batch_size);
+        recurrent_tensor_feature_input_.reserve(max_batch_size);
+        recurrent_tensor_action_input_.reserve(max_batch_size);
     }
 
     std::string toString() const override
@@ -64,54 +68,55 @@ public:
     int pushBackInitialData(std::vector<float> features)
     {
         assert(static_cast<int>(features.size()) == getNumInputChannels() * getInputChannelHeight() * getInputChannelWidth());
+        std::pair<int, float*> input = allocateInitialInput();
+        std::copy(features.begin(), features.end(), input.second);
+        return input.first;
+    }
 
-        int index;
-        {
-            std::lock_guard<std::mutex> lock(initial_mutex_);
-            index = initial_input_batch_size_++;
-            initial_tensor_input_.resize(initial_input_batch_size_);
-        }
-        initial_tensor_input_[index] = torch::from_blob(features.data(), {1, getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth()}).clone();
-        return index;
+    std::pair<int, float*> allocateInitialInput(NetworkModel* model = nullptr)
+    {
+        // return the batch index and the address to write its features to, e.g., by BaseEnv::writeFeatures
+        // the input is evaluated by the given model, e.g., the model an actor started its search with, or by the latest model if not given
+        int index = initial_input_batch_size_++;
+        return {index, initial_tensor_input_.getEntry(index, model)};
     }
 
-    int pushBackRecurrentData(std::vector<float> features, std::vector<float> actions)
+    int pushBackRecurrentData(const std::vector<float>& features, const std::vector<float>& actions)
     {
         assert(static_cast<int>(features.size()) == getNumHiddenChannels() * getHiddenChannelHeight() * getHiddenChannelWidth());
         assert(static_cast<int>(actions.size()) == getNumActionFeatureChannels() * getHiddenChannelHeight() * getHiddenChannelWidth());
 
-        int index;
-        {
-            std::lock_guard<std::mutex> lock(recurrent_mutex_);
-            index = recurrent_input_batch_size_++;
-            recurrent_tensor_feature_input_.resize(recurrent_input_batch_size_);
-            recurrent_tensor_action_input_.resize(recurrent_input_batch_size_);
-        }
-        recurrent_tensor_feature_input_[index] = torch::from_blob(features.data(), {1, getNumHiddenChannels(), getHiddenChannelHeight(), getHiddenChannelWidth()}).clone();
-        recurrent_tensor_action_input_[index] = torch::from_blob(actions.data(), {1, getNumActionFeatureChannels(), getHiddenChannelHeight(), getHiddenChannelWidth()}).clone();
-        return index;
+        std::pair<int, float*> input = allocateRecurrentInput(actions);
+        std::copy(features.begin(), features.end(), input.second);
+        return input.first;
+    }
+
+    std::pair<int, float*> allocateRecurrentInput(const std::vector<float>& actions, NetworkModel* model = nullptr)
+    {
+        // return the batch index and the address to write the hidden state to, e.g., by gathering it from the hidden states of the tree, which avoids cloning it to a vector first
+        assert(static_cast<int>(actions.size()) == getNumActionFeatureChannels() * getHiddenChannelHeight() * getHiddenChannelWidth());
+        int index = recurrent_input_batch_size_++;
+        std::copy(actions.begin(), actions.end(), recurrent_tensor_action_input_.getEntry(index));
+        return {index, recurrent_tensor_feature_input_.getEntry(index, model)};
     }
 
     inline std::vector<std::shared_ptr<NetworkOutput>> initialInference()
     {
-        assert(initial_input_batch_size_ > 0);
-        auto outputs = forward("initial_inference", {torch::cat(initial_tensor_input_).to(getDevice())}, initial_input_batch_size_);
-        initial_tensor_input_.clear();
-        initial_tensor_input_.reserve(kReserved_batch_size);
+        const int batch_size = initial_input_batch_size_;
+        assert(batch_size > 0);
+        auto outputs = forward("initial_inference", {initial_tensor_input_.getBatch(batch_size)}, initial_tensor_input_.getModels(batch_size));
+        initial_tensor_input_.clear(batch_size);
         initial_input_batch_size_ = 0;
         return outputs;
     }
 
     inline std::vector<std::shared_ptr<NetworkOutput>> recurrentInference()
     {
-        assert(recurrent_input_batch_size_ > 0);
-        auto outputs = forward("recurrent_inference",
-                               {{torch::cat(recurrent_tensor_feature_input_).to(getDevice())}, {torch::cat(recurrent_tensor_action_input_).to(getDevice())}},
-                               recurrent_input_batch_size_);
-        recurrent_tensor_feature_input_.clear();
-        recurrent_tensor_feature_input_.reserve(kReserved_batch_size);
-        recurrent_tensor_action_input_.clear();
-        recurrent_tensor_action_input_.reserve(kReserved_batch_size);
+        const int batch_size = recurrent_input_batch_size_;
+        assert(batch_size > 0);
+        auto outputs = forward("recurrent_inference", {recurrent_tensor_feature_input_.getBatch(batch_size), recurrent_tensor_action_input_.getBatch(batch_size)}, recurrent_tensor_feature_input_.getModels(batch_size));
+        recurrent_tensor_feature_input_.clear(batch_size);
+        recurrent_tensor_action_input_.clear(batch_size);
         recurrent_input_batch_size_ = 0;
         return outputs;
     }
@@ -121,72 +126,92 @@ public:
     inline int getRecurrentInputBatchSize() const { return recurrent_input_batch_size_; }
 
 protected:
-    std::vector<std::shared_ptr<NetworkOutput>> forward(const std::string& method, const std::vector<torch::jit::IValue>& inputs, int batch_size)
+    std::vector<std::shared_ptr<NetworkOutput>> forward(const std::string& method, const std::vector<torch::Tensor>& batches, const std::vector<NetworkModel*>& input_models)
     {
-        assert(network_.find_method(method));
-
-        auto forward_result = network_.get_method(method)(inputs).toGenericDict();
-        auto policy_output = forward_result.at("policy").toTensor().to(at::kCPU);
-        auto policy_logits_output = forward_result.at("policy_logit").toTensor().to(at::kCPU);
-        auto value_output = forward_result.at("value").toTensor().to(at::kCPU);
-        auto reward_output = (forward_result.contains("reward") ? forward_result.at("reward").toTensor().to(at::kCPU) : torch::zeros(0));
-        auto hidden_state_output = forward_result.at("hidden_state").toTensor().to(at::kCPU);
-        assert(policy_output.numel() == batch_size * getActionSize());
-        assert(policy_logits_output.numel() == batch_size * getActionSize());
-        assert((getNetworkTypeName() != "muzero_atari" && value_output.numel() == batch_size) || (getNetworkTypeName() == "muzero_atari" && value_output.numel() == batch_size * getDiscreteValueSize()));
-        assert(!forward_result.contains("reward") || (forward_result.contains("reward") && reward_output.numel() == batch_size * getDiscreteValueSize()));
-        assert(hidden_state_output.numel() == batch_size * getNumHiddenChannels() * getHiddenChannelHeight() * getHiddenChannelWidth());
+        const int batch_size = input_models.size();
+        utils::Profiler::addBatchSize(batch_size);
+        utils::ProfileTimer timer(utils::ProfilePhase::kTensor);
+        std::shared_ptr<NetworkModel> latest_model = getModel(); // kept until the forward is done
+        std::vector<std::pair<NetworkModel*, std::vector<int64_t>>> model_rows = groupInputsByModel(input_models, latest_model.get());
+
+        // each row of the batch output is [policy, policy logits, value, reward, hidden state], the hidden states are only evaluated by the model that produced them
+        std::shared_ptr<BatchOutput<MuZeroNetworkOutput>> batch_output;
+        int value_size = 0, reward_size = 0;
+        for (auto& [model, rows] : model_rows) {
+            torch::Tensor row_indices = (rows.empty() ? torch::Tensor() : torch::tensor(rows));
+            std::vector<torch::jit::IValue> inputs;
+            for (const torch::Tensor& batch : batches) { inputs.push_back(toInputTensor(rows.empty() ? batch : batch.index_select(0, row_indices), *model)); }
+            torch::Tensor output = forwardModel(*model, method, inputs, (rows.empty() ? batch_size : static_cast<int>(rows.size())), value_size, reward_size, timer);
+            if (!batch_output) { batch_output = std::make_shared<BatchOutput<MuZeroNetworkOutput>>(batch_size, output.size(1)); }
+            if (rows.empty()) {
+                batch_output->getTensor().copy_(output);
+            } else {
+                batch_output->getTensor().index_copy_(0, row_indices, output.to(torch::kCPU, torch::kFloat32));
+            }
+        }
 
         const int policy_size = getActionSize();
         const int hidden_state_size = getNumHiddenChannels() * getHiddenChannelHeight() * getHiddenChannelWidth();
-        std::vector<std::shared_ptr<NetworkOutput>> network_outputs;
         for (int i = 0; i < batch_size; ++i) {
-            network_outputs.emplace_back(std::make_shared<MuZeroNetworkOutput>(policy_size, hidden_state_size));
-            auto muzero_network_output = std::static_pointer_cast<MuZeroNetworkOutput>(network_outputs.back());
-
-            std::copy(policy_output.data_ptr<float>() + i * policy_size,
-                      policy_output.data_ptr<float>() + (i + 1) * policy_size,
-                      muzero_network_output->policy_.begin());
-            std::copy(policy_logits_output.data_ptr<float>() + i * policy_size,
-                      policy_logits_output.data_ptr<float>() + (i + 1) * policy_size,
-                      muzero_network_output->policy_logits_.begin());
-            std::copy(hidden_state_output.data_ptr<float>() + i * hidden_state_size,
-                      hidden_state_output.data_ptr<float>() + (i + 1) * hidden_state_size,
-                      muzero_network_output->hidden_state_.begin());
+            MuZeroNetworkOutput& muzero_network_output = batch_output->outputs_[i];
+            const float* row = batch_output->getRow(i);
+            const float* value_row = row + 2 * policy_size;
+            const float* reward_row = value_row + value_size;
+
+            muzero_network_output.policy_ = OutputRow(row, policy_size);
+            muzero_network_output.policy_logits_ = OutputRow(row + policy_size, policy_size);
+            muzero_network_output.hidden_state_ = OutputRow(reward_row + reward_size, hidden_state_size);
 
             if (getNetworkTypeName() == "muzero_atari") {
                 int start_value = -getDiscreteValueSize() / 2;
-                muzero_network_output->value_ = std::accumulate(value_output.data_ptr<float>() + i * getDiscreteValueSize(),
-                                                                value_output.data_ptr<float>() + (i + 1) * getDiscreteValueSize(),
-                                                                0.0f,
-                                                                [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
-                muzero_network_output->value_ = utils::invertValue(muzero_network_output->value_);
-                if (forward_result.contains("reward")) {
+                muzero_network_output.value_ = std::accumulate(value_row, value_row + value_size, 0.0f, [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
+                muzero_network_output.value_ = utils::invertValue(muzero_network_output.value_);
+                if (reward_size > 0) {
                     start_value = -getDiscreteValueSize() / 2;
-                    muzero_network_output->reward_ = std::accumulate(reward_output.data_ptr<float>() + i * getDiscreteValueSize(),
-                                                                     reward_output.data_ptr<float>() + (i + 1) * getDiscreteValueSize(),
-                                                                     0.0f,
-                                                                     [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
-                    muzero_network_output->reward_ = utils::invertValue(muzero_network_output->reward_);
+                    muzero_network_output.reward_ = std::accumulate(reward_row, reward_row + reward_size, 0.0f, [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
+                    muzero_network_output.reward_ = utils::invertValue(muzero_network_output.reward_);
                 }
             } else {
-                muzero_network_output->value_ = value_output[i].item<float>();
+                muzero_network_output.value_ = value_row[0];
             }
         }
 
-        return network_outputs;
+        return BatchOutput<MuZeroNetworkOutput>::share(batch_output);
+    }
+
+    torch::Tensor forwardModel(NetworkModel& model, const std::string& method, const std::vector<torch::jit::IValue>& inputs, int batch_size, int& value_size, int& reward_size, utils::ProfileTimer& timer)
+    {
+        // return the [batch, policy + policy logits + value + reward + hidden state] outputs of the model, still on the device
+        assert(model.module_.find_method(method));
+        timer.next(utils::ProfilePhase::kForward);
+        auto forward_result = model.module_.get_method(method)(inputs).toGenericDict();
+        auto policy_output = forward_result.at("policy").toTensor();
+        auto policy_logits_output = forward_result.at("policy_logit").toTensor();
+        auto value_output = forward_result.at("value").toTensor();
+        auto reward_output = (forward_result.contains("reward") ? forward_result.at("reward").toTensor() : torch::zeros(0));
+        auto hidden_state_output = forward_result.at("hidden_state").toTensor();
+        assert(policy_output.numel() == batch_size * getActionSize());
+        assert(policy_logits_output.numel() == batch_size * getActionSize());
+        assert((getNetworkTypeName() != "muzero_atari" && value_output.numel() == batch_size) || (getNetworkTypeName() == "muzero_atari" && value_output.numel() == batch_size * getDiscreteValueSize()));
+        assert(!forward_result.contains("reward") || (forward_result.contains("reward") && reward_output.numel() == batch_size * getDiscreteValueSize()));
+        assert(hidden_state_output.numel() == batch_size * getNumHiddenChannels() * getHiddenChannelHeight() * getHiddenChannelWidth());
+
+        // a GPU forward runs asynchronously, so the time waiting for it is counted in decode when the outputs are copied
+        timer.next(utils::ProfilePhase::kDecode);
+        value_size = value_output.numel() / batch_size;
+        reward_size = reward_output.numel() / batch_size;
+        std::vector<torch::Tensor> outputs{policy_output.reshape({batch_size, -1}), policy_logits_output.reshape({batch_size, -1}), value_output.reshape({batch_size, -1})};
+        if (reward_size > 0) { outputs.push_back(reward_output.reshape({batch_size, -1})); }
+        outputs.push_back(hidden_state_output.reshape({batch_size, -1}));
+        return torch::cat(outputs, 1);
     }
 
     int num_action_feature_channels_;
-    int initial_input_batch_size_;
-    int recurrent_input_batch_size_;
-    std::mutex initial_mutex_;
-    std::mutex recurrent_mutex_;
-    std::vector<torch::Tensor> initial_tensor_input_;
-    std::vector<torch::Tensor> recurrent_tensor_feature_input_;
-    std::vector<torch::Tensor> recurrent_tensor_action_input_;
-
-    const int kReserved_batch_size = 4096;
+    std::atomic<int> initial_input_batch_size_;
+    std::atomic<int> recurrent_input_batch_size_;
+    BatchInputBuffer initial_tensor_input_;
+    BatchInputBuffer recurrent_tensor_feature_input_;
+    BatchInputBuffer recurrent_tensor_action_input_;
 };
 
 } // namespace minizero::network
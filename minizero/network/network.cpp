@@ -1,25 +1,75 @@
 #include "network.h"
+#include <ATen/Parallel.h>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <utility>
 
 namespace minizero::network {
 
+namespace {
+
+bool isCPUBF16Supported()
+{
+    // only the CPUs with bf16 instructions (AVX512-BF16 or AMX) are faster in bf16, the others emulate it
+    std::ifstream fin("/proc/cpuinfo");
+    for (std::string line; std::getline(fin, line);) {
+        if (line.rfind("flags", 0) != 0) { continue; }
+        return (line.find(" avx512_bf16") != std::string::npos || line.find(" amx_bf16") != std::string::npos);
+    }
+    return false;
+}
+
+bool isQuantized(const torch::jit::script::Module& network)
+{
+    // e.g., the linear layers quantized by learner/quantize.py are torch.ao.nn.quantized.dynamic modules
+    for (const auto& module : network.named_modules()) {
+        if (module.value.type()->name() && module.value.type()->name()->qualifiedName().find(".quantized.") != std::string::npos) { return true; }
+    }
+    return false;
+}
+
+} // namespace
+
+bool Network::use_cpu_bf16_ = false;
+
+void Network::setCPUOptions(const std::string& precision, int num_threads)
+{
+    use_cpu_bf16_ = false;
+    if (precision == "bf16") {
+        use_cpu_bf16_ = isCPUBF16Supported();
+        if (!use_cpu_bf16_) { std::cerr << "The CPU does not support bf16, the networks on CPUs run in fp32." << std::endl; }
+    } else if (precision != "fp32") {
+        std::cerr << "Unknown CPU precision " << precision << ", the networks on CPUs run in fp32." << std::endl;
+    }
+
+    // the intra-op thread pool of LibTorch is shared by all networks in the process
+    if (num_threads > 0) { at::set_num_threads(num_threads); }
+}
+
 Network::Network()
 {
     gpu_id_ = -1;
     num_input_channels_ = input_channel_height_ = input_channel_width_ = -1;
     num_hidden_channels_ = hidden_channel_height_ = hidden_channel_width_ = -1;
     num_blocks_ = action_size_ = num_value_hidden_channels_ = discrete_value_size_ = -1;
-    game_name_ = network_type_name_ = network_file_name_ = "";
+    game_name_ = network_type_name_ = "";
+    model_ = std::make_shared<NetworkModel>();
+    model_->key_ = 0;
+    model_->input_type_ = torch::kFloat32;
 }
 
 void Network::loadModel(const std::string& nn_file_name, const int gpu_id)
 {
+    // a model loaded synchronously replaces the model loaded in the background
+    waitForShadowModel();
     gpu_id_ = gpu_id;
-    network_file_name_ = nn_file_name;
 
     // load model weights
+    std::shared_ptr<NetworkModel> model;
     try {
-        network_ = torch::jit::load(network_file_name_, getDevice());
-        network_.eval();
+        model = loadNetworkModel(nn_file_name);
     } catch (const c10::Error& e) {
         std::cerr << e.msg() << std::endl;
         assert(false);
@@ -27,18 +77,87 @@ void Network::loadModel(const std::string& nn_file_name, const int gpu_id)
 
     // network hyper-parameter
     std::vector<torch::jit::IValue> dummy;
-    num_input_channels_ = network_.get_method("get_num_input_channels")(dummy).toInt();
-    input_channel_height_ = network_.get_method("get_input_channel_height")(dummy).toInt();
-    input_channel_width_ = network_.get_method("get_input_channel_width")(dummy).toInt();
-    num_hidden_channels_ = network_.get_method("get_num_hidden_channels")(dummy).toInt();
-    hidden_channel_height_ = network_.get_method("get_hidden_channel_height")(dummy).toInt();
-    hidden_channel_width_ = network_.get_method("get_hidden_channel_width")(dummy).toInt();
-    num_blocks_ = network_.get_method("get_num_blocks")(dummy).toInt();
-    action_size_ = network_.get_method("get_action_size")(dummy).toInt();
-    num_value_hidden_channels_ = network_.get_method("get_num_value_hidden_channels")(dummy).toInt();
-    discrete_value_size_ = network_.get_method("get_discrete_value_size")(dummy).toInt();
-    game_name_ = network_.get_method("get_game_name")(dummy).toString()->string();
-    network_type_name_ = network_.get_method("get_type_name")(dummy).toString()->string();
+    const torch::jit::script::Module& network = model->module_;
+    num_input_channels_ = network.get_method("get_num_input_channels")(dummy).toInt();
+    input_channel_height_ = network.get_method("get_input_channel_height")(dummy).toInt();
+    input_channel_width_ = network.get_method("get_input_channel_width")(dummy).toInt();
+    num_hidden_channels_ = network.get_method("get_num_hidden_channels")(dummy).toInt();
+    hidden_channel_height_ = network.get_method("get_hidden_channel_height")(dummy).toInt();
+    hidden_channel_width_ = network.get_method("get_hidden_channel_width")(dummy).toInt();
+    num_blocks_ = network.get_method("get_num_blocks")(dummy).toInt();
+    action_size_ = network.get_method("get_action_size")(dummy).toInt();
+    num_value_hidden_channels_ = network.get_method("get_num_value_hidden_channels")(dummy).toInt();
+    discrete_value_size_ = network.get_method("get_discrete_value_size")(dummy).toInt();
+    game_name_ = network.get_method("get_game_name")(dummy).toString()->string();
+    network_type_name_ = network.get_method("get_type_name")(dummy).toString()->string();
+
+    std::lock_guard<std::mutex> lock(model_mutex_);
+    model_ = model;
+}
+
+void Network::loadShadowModel(const std::string& nn_file_name)
+{
+    // deserialize the model and move its weights to the device in the background, the actors keep evaluating by their models meanwhile
+    waitForShadowModel();
+    shadow_network_loader_ = std::thread([this, nn_file_name]() {
+        std::shared_ptr<NetworkModel> model;
+        try {
+            model = loadNetworkModel(nn_file_name);
+        } catch (const c10::Error& e) {
+            std::cerr << e.msg() << std::endl;
+            return;
+        }
+
+        // only the weights can be replaced, the batch buffers are allocated by the hyper-parameters of the first model
+        std::vector<torch::jit::IValue> dummy;
+        const torch::jit::script::Module& network = model->module_;
+        if (network.get_method("get_type_name")(dummy).toString()->string() != network_type_name_ ||
+            network.get_method("get_num_input_channels")(dummy).toInt() != num_input_channels_ ||
+            network.get_method("get_num_hidden_channels")(dummy).toInt() != num_hidden_channels_ ||
+            network.get_method("get_action_size")(dummy).toInt() != action_size_) {
+            std::cerr << "Failed to swap to " << nn_file_name << " since its architecture is different." << std::endl;
+            return;
+        }
+
+        // the actors switch to the model when they start their next searches
+        std::lock_guard<std::mutex> lock(model_mutex_);
+        model_ = model;
+    });
+}
+
+void Network::waitForShadowModel()
+{
+    if (shadow_network_loader_.joinable()) { shadow_network_loader_.join(); }
+}
+
+std::shared_ptr<NetworkModel> Network::loadNetworkModel(const std::string& nn_file_name) const
+{
+    // the networks on CPUs run in bf16 if enabled, except for the models quantized to int8 which take fp32 inputs
+    auto model = std::make_shared<NetworkModel>();
+    model->module_ = torch::jit::load(nn_file_name, getDevice());
+    model->module_.eval();
+    model->file_name_ = nn_file_name;
+    model->key_ = std::hash<std::string>()(nn_file_name);
+    model->input_type_ = torch::kFloat32;
+    if (gpu_id_ == -1 && use_cpu_bf16_ && !isQuantized(model->module_)) {
+        model->module_.to(torch::kBFloat16);
+        model->input_type_ = torch::kBFloat16;
+    }
+    return model;
+}
+
+std::vector<std::pair<NetworkModel*, std::vector<int64_t>>> Network::groupInputsByModel(const std::vector<NetworkModel*>& input_models, NetworkModel* latest_model) const
+{
+    // the rows of the inputs evaluated by each model, the rows are left empty if the whole batch is evaluated by one model
+    std::vector<std::pair<NetworkModel*, std::vector<int64_t>>> model_rows;
+    for (size_t i = 0; i < input_models.size(); ++i) {
+        NetworkModel* model = (input_models[i] ? input_models[i] : latest_model);
+        auto it = std::find_if(model_rows.begin(), model_rows.end(), [model](const std::pair<NetworkModel*, std::vector<int64_t>>& rows) { return rows.first == model; });
+        if (it == model_rows.end()) { it = model_rows.emplace(model_rows.end(), model, std::vector<int64_t>()); }
+        it->second.push_back(i);
+    }
+    if (model_rows.size() == 1) { model_rows[0].second.clear(); }
+    return model_rows;
 }
 
 std::string Network::toString() const
@@ -57,8 +176,83 @@ std::string Network::toString() const
     oss << "Discrete value size: " << discrete_value_size_ << std::endl;
     oss << "Game name: " << game_name_ << std::endl;
     oss << "Network type name: " << network_type_name_ << std::endl;
-    oss << "Network file name: " << network_file_name_ << std::endl;
+    oss << "Network file name: " << getNetworkFileName() << std::endl;
     return oss.str();
 }
 
+void BatchInputBuffer::reset(const std::vector<int64_t>& entry_shape, bool pinned_memory)
+{
+    capacity_ = 0;
+    entry_size_ = 1;
+    for (int64_t size : entry_shape) { entry_size_ *= size; }
+    pinned_memory_ = pinned_memory;
+    data_ = nullptr;
+    buffer_ = torch::Tensor();
+    entry_shape_ = entry_shape;
+    models_.clear();
+    overflow_entries_.clear();
+    overflow_models_.clear();
+}
+
+float* BatchInputBuffer::getEntry(int index, NetworkModel* model /*= nullptr*/)
+{
+    if (index < capacity_) {
+        models_[index] = model;
+        return data_ + index * entry_size_;
+    }
+
+    // the batch is larger than the buffer, allocate the entry separately until the buffer grows in clear()
+    std::vector<int64_t> shape{1};
+    shape.insert(shape.end(), entry_shape_.begin(), entry_shape_.end());
+    torch::Tensor entry = torch::empty(shape, torch::TensorOptions().dtype(torch::kFloat32).pinned_memory(pinned_memory_));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index - capacity_ >= static_cast<int>(overflow_entries_.size())) {
+        overflow_entries_.resize(index - capacity_ + 1);
+        overflow_models_.resize(index - capacity_ + 1);
+    }
+    overflow_entries_[index - capacity_] = entry;
+    overflow_models_[index - capacity_] = model;
+    return entry.data_ptr<float>();
+}
+
+torch::Tensor BatchInputBuffer::getBatch(int batch_size)
+{
+    // only the used prefix is passed to the model
+    if (batch_size <= capacity_) { return buffer_.narrow(0, 0, batch_size); }
+
+    assert(batch_size == capacity_ + static_cast<int>(overflow_entries_.size()));
+    std::vector<torch::Tensor> entries;
+    if (capacity_ > 0) { entries.push_back(buffer_); }
+    entries.insert(entries.end(), overflow_entries_.begin(), overflow_entries_.end());
+    return torch::cat(entries);
+}
+
+std::vector<NetworkModel*> BatchInputBuffer::getModels(int batch_size) const
+{
+    std::vector<NetworkModel*> models(models_.begin(), models_.begin() + std::min(batch_size, capacity_));
+    if (batch_size > capacity_) { models.insert(models.end(), overflow_models_.begin(), overflow_models_.end()); }
+    return models;
+}
+
+void BatchInputBuffer::reserve(int capacity)
+{
+    assert(overflow_entries_.empty());
+    if (capacity <= capacity_) { return; }
+
+    std::vector<int64_t> shape{capacity};
+    shape.insert(shape.end(), entry_shape_.begin(), entry_shape_.end());
+    capacity_ = capacity;
+    buffer_ = torch::empty(shape, torch::TensorOptions().dtype(torch::kFloat32).pinned_memory(pinned_memory_));
+    data_ = buffer_.data_ptr<float>();
+    models_.resize(capacity);
+}
+
+void BatchInputBuffer::clear(int batch_size)
+{
+    overflow_entries_.clear();
+    overflow_models_.clear();
+    reserve(batch_size);
+}
+
 } // namespace minizero::network
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <torch/script.h>
+#include <utility>
 #include <vector>
 
 namespace minizero::network {
@@ -12,14 +16,98 @@ public:
     virtual ~NetworkOutput() = default;
 };
 
+// a row of the outputs of a batch on the host, e.g., the policy of an input, it refers to the data owned by the BatchOutput of the batch
+class OutputRow {
+public:
+    OutputRow() : data_(nullptr), size_(0) {}
+    OutputRow(const float* data, size_t size) : data_(data), size_(size) {}
+
+    inline const float* data() const { return data_; }
+    inline size_t size() const { return size_; }
+    inline const float* begin() const { return data_; }
+    inline const float* end() const { return data_ + size_; }
+    inline float operator[](size_t index) const { return data_[index]; }
+
+private:
+    const float* data_;
+    size_t size_;
+};
+
+// the outputs of a batch in one allocation, the output of each input shares the ownership of the batch instead of copying its rows
+template <class Output>
+class BatchOutput {
+public:
+    BatchOutput(int batch_size, int64_t row_size)
+        : row_size_(row_size),
+          data_(batch_size * row_size),
+          outputs_(batch_size) {}
+
+    inline float* getRow(int index) { return data_.data() + index * row_size_; }
+    inline torch::Tensor getTensor() { return torch::from_blob(data_.data(), {static_cast<int64_t>(outputs_.size()), row_size_}); } // for copying the network outputs to the rows in one transfer
+
+    static std::vector<std::shared_ptr<NetworkOutput>> share(const std::shared_ptr<BatchOutput>& batch)
+    {
+        std::vector<std::shared_ptr<NetworkOutput>> network_outputs;
+        network_outputs.reserve(batch->outputs_.size());
+        for (auto& output : batch->outputs_) { network_outputs.push_back(std::shared_ptr<NetworkOutput>(batch, &output)); }
+        return network_outputs;
+    }
+
+    int64_t row_size_;
+    std::vector<float> data_;
+    std::vector<Output> outputs_;
+};
+
+// a loaded model, the actors keep evaluating by the model they started a search with while another model is loaded
+class NetworkModel {
+public:
+    torch::jit::script::Module module_;
+    std::string file_name_;
+    uint64_t key_; // the hash of file_name_, the same for the networks loading the same model
+    torch::ScalarType input_type_; // bf16 for the networks on CPUs if enabled by Network::setCPUOptions(), otherwise fp32
+};
+
+// a contiguous [capacity, entry_shape] input buffer of a batch, entries are written at their batch indices without locks
+// the capacity is reserved for the maximum batch size up front, entries beyond it are stored separately, and the capacity grows to the largest batch size when the buffer is cleared
+class BatchInputBuffer {
+public:
+    BatchInputBuffer() { reset({}, false); }
+
+    void reset(const std::vector<int64_t>& entry_shape, bool pinned_memory);
+    void reserve(int capacity);
+    float* getEntry(int index, NetworkModel* model = nullptr);
+    torch::Tensor getBatch(int batch_size);
+    std::vector<NetworkModel*> getModels(int batch_size) const;
+    void clear(int batch_size);
+
+private:
+    int capacity_;
+    int64_t entry_size_;
+    bool pinned_memory_;
+    float* data_;
+    torch::Tensor buffer_;
+    std::vector<int64_t> entry_shape_;
+    std::vector<NetworkModel*> models_; // the model evaluating each entry, nullptr for the latest model
+    std::mutex mutex_;
+    std::vector<torch::Tensor> overflow_entries_;
+    std::vector<NetworkModel*> overflow_models_;
+};
+
 class Network {
 public:
     Network();
-    virtual ~Network() = default;
+    virtual ~Network() { waitForShadowModel(); }
 
     virtual void loadModel(const std::string& nn_file_name, const int gpu_id);
+    virtual void loadShadowModel(const std::string& nn_file_name);
+    virtual void reserveBatchSize(int max_batch_size) {} // allocate the input buffers for the batches up to max_batch_size, before evaluating any batch
     virtual std::string toString() const;
 
+    // the options of the networks on CPUs (gpu_id = -1), set before loading the models
+    // precision is "fp32" or "bf16", bf16 falls back to fp32 on CPUs without bf16 instructions; num_threads is the number of intra-op threads of LibTorch, 0 for its default
+    static void setCPUOptions(const std::string& precision, int num_threads);
+    static inline bool useCPUBF16() { return use_cpu_bf16_; }
+
     inline int getGPUID() const { return gpu_id_; }
     inline int getNumInputChannels() const { return num_input_channels_; }
     inline int getInputChannelHeight() const { return input_channel_height_; }
@@ -33,10 +121,21 @@ public:
     inline int getDiscreteValueSize() const { return discrete_value_size_; }
     inline std::string getGameName() const { return game_name_; }
     inline std::string getNetworkTypeName() const { return network_type_name_; }
-    inline std::string getNetworkFileName() const { return network_file_name_; }
+    inline std::string getNetworkFileName() const { return getModel()->file_name_; }
+    inline uint64_t getModelKey() const { return getModel()->key_; } // changes when another model is loaded, e.g., for invalidating cached evaluations
+    inline std::shared_ptr<NetworkModel> getModel() const
+    {
+        // the latest loaded model, an actor takes it at the start of a search and evaluates all leaves of the search by it
+        std::lock_guard<std::mutex> lock(model_mutex_);
+        return model_;
+    }
 
 protected:
     inline torch::Device getDevice() const { return (gpu_id_ == -1 ? torch::Device("cpu") : torch::Device(torch::kCUDA, gpu_id_)); }
+    inline torch::Tensor toInputTensor(const torch::Tensor& batch, const NetworkModel& model) const { return batch.to(getDevice(), model.input_type_); }
+    std::shared_ptr<NetworkModel> loadNetworkModel(const std::string& nn_file_name) const;
+    std::vector<std::pair<NetworkModel*, std::vector<int64_t>>> groupInputsByModel(const std::vector<NetworkModel*>& input_models, NetworkModel* latest_model) const;
+    void waitForShadowModel();
 
     int gpu_id_;
     int num_input_channels_;
@@ -51,8 +150,11 @@ protected:
     int discrete_value_size_;
     std::string game_name_;
     std::string network_type_name_;
-    std::string network_file_name_;
-    torch::jit::script::Module network_;
+    std::shared_ptr<NetworkModel> model_; // the latest model, the models of the running searches are kept by the actors
+    std::thread shadow_network_loader_;
+    mutable std::mutex model_mutex_;
+
+    static bool use_cpu_bf16_;
 };
 
 } // namespace minizero::network
@@ -0,0 +1,111 @@
+#include "nn_cache.h"
+#include <algorithm>
+
+namespace minizero::network {
+
+NNCache::NNCache(int capacity, int num_shards)
+    : capacity_(0),
+      shards_(std::max(1, std::min(num_shards, capacity)))
+{
+    // the entries are allocated up front, so the cache never grows beyond its capacity
+    int shard_capacity = std::max(1, (capacity + static_cast<int>(shards_.size()) - 1) / static_cast<int>(shards_.size()));
+    for (auto& shard : shards_) {
+        shard.entries_.resize(shard_capacity);
+        shard.entry_index_.reserve(shard_capacity);
+        capacity_ += shard_capacity;
+    }
+    clear();
+    resetStatistics();
+}
+
+std::shared_ptr<AlphaZeroNetworkOutput> NNCache::lookup(uint64_t hash_key, int rotation, uint64_t model_key)
+{
+    uint64_t key = getKey(hash_key, rotation);
+    Shard& shard = getShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+    ++shard.num_lookups_;
+    auto it = shard.entry_index_.find(key);
+    if (it == shard.entry_index_.end()) { return nullptr; }
+    Entry& entry = shard.entries_[it->second];
+    if (entry.model_key_ != model_key) { return nullptr; }
+    ++shard.num_hits_;
+    entry.is_referenced_ = true;
+    return entry.output_;
+}
+
+void NNCache::insert(uint64_t hash_key, int rotation, uint64_t model_key, const std::shared_ptr<AlphaZeroNetworkOutput>& output)
+{
+    uint64_t key = getKey(hash_key, rotation);
+    Shard& shard = getShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+    auto it = shard.entry_index_.find(key);
+    if (it != shard.entry_index_.end()) {
+        Entry& entry = shard.entries_[it->second];
+        entry.model_key_ = model_key;
+        entry.output_ = output;
+        return;
+    }
+
+    // the clock hand skips the referenced entries once (clearing their reference bits) and replaces the first unreferenced one
+    int index;
+    if (shard.num_used_entries_ < static_cast<int>(shard.entries_.size())) {
+        index = shard.num_used_entries_++;
+    } else {
+        while (shard.entries_[shard.clock_hand_].is_referenced_) {
+            shard.entries_[shard.clock_hand_].is_referenced_ = false;
+            shard.clock_hand_ = (shard.clock_hand_ + 1) % shard.entries_.size();
+        }
+        index = shard.clock_hand_;
+        shard.clock_hand_ = (shard.clock_hand_ + 1) % shard.entries_.size();
+        shard.entry_index_.erase(shard.entries_[index].key_);
+    }
+    shard.entries_[index] = Entry{key, model_key, false, output};
+    shard.entry_index_[key] = index;
+}
+
+void NNCache::clear()
+{
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        shard.clock_hand_ = 0;
+        shard.num_used_entries_ = 0;
+        for (auto& entry : shard.entries_) { entry = Entry{0, 0, false, nullptr}; }
+        shard.entry_index_.clear();
+    }
+}
+
+int64_t NNCache::getNumLookups() const
+{
+    int64_t num_lookups = 0;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        num_lookups += shard.num_lookups_;
+    }
+    return num_lookups;
+}
+
+int64_t NNCache::getNumHits() const
+{
+    int64_t num_hits = 0;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        num_hits += shard.num_hits_;
+    }
+    return num_hits;
+}
+
+void NNCache::resetStatistics()
+{
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        shard.num_lookups_ = shard.num_hits_ = 0;
+    }
+}
+
+int64_t NNCache::getEntryMemorySize(int action_size)
+{
+    // the entry, its index in the hash map, and the output copy (AlphaZeroNetworkOutput::clone) with its policy and policy logits
+    return sizeof(Entry) + 4 * sizeof(uint64_t) + sizeof(BatchOutput<AlphaZeroNetworkOutput>) + sizeof(AlphaZeroNetworkOutput) + 2 * sizeof(float) * action_size + 4 * sizeof(void*);
+}
+
+} // namespace minizero::network
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "alphazero_network.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace minizero::network {
+
+// a fixed-capacity cache of the AlphaZero evaluations shared by the actors, keyed by the position hash key and the feature rotation
+// the entries are split into shards with their own locks, and each shard replaces its entries by the clock (second-chance) policy
+// each entry records the model that evaluated it, so the entries of the previous models are never returned after a model is loaded
+class NNCache {
+public:
+    NNCache(int capacity, int num_shards);
+
+    std::shared_ptr<AlphaZeroNetworkOutput> lookup(uint64_t hash_key, int rotation, uint64_t model_key);
+    void insert(uint64_t hash_key, int rotation, uint64_t model_key, const std::shared_ptr<AlphaZeroNetworkOutput>& output); // the output should own its rows, e.g., by AlphaZeroNetworkOutput::clone()
+    void clear();
+
+    int64_t getNumLookups() const;
+    int64_t getNumHits() const;
+    void resetStatistics();
+
+    inline int getCapacity() const { return capacity_; }
+
+    // the approximate memory of an entry, for sizing the cache by memory
+    static int64_t getEntryMemorySize(int action_size);
+
+private:
+    class Entry {
+    public:
+        uint64_t key_;
+        uint64_t model_key_;
+        bool is_referenced_;
+        std::shared_ptr<AlphaZeroNetworkOutput> output_;
+    };
+
+    class alignas(64) Shard {
+    public:
+        mutable std::mutex mutex_;
+        int clock_hand_;
+        int num_used_entries_;
+        std::vector<Entry> entries_;
+        std::unordered_map<uint64_t, int> entry_index_; // key -> index of entries_
+        int64_t num_lookups_;
+        int64_t num_hits_;
+    };
+
+    static inline uint64_t getKey(uint64_t hash_key, int rotation) { return hash_key ^ (static_cast<uint64_t>(rotation + 1) * 0x9E3779B97F4A7C15ULL); }
+    inline Shard& getShard(uint64_t key) { return shards_[(key ^ (key >> 32)) % shards_.size()]; }
+
+    int capacity_;
+    std::vector<Shard> shards_;
+};
+
+} // namespace minizero::network
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+
+namespace minizero::utils {
+
+class MPSCQueueNode {
+public:
+    MPSCQueueNode()
+        : mpsc_next_(nullptr) {}
+
+    std::atomic<MPSCQueueNode*> mpsc_next_;
+};
+
+// an intrusive lock-free queue (Vyukov), push is thread-safe and pop must be called by a single consumer thread
+// the nodes are owned by the caller and must derive from MPSCQueueNode, a node can be pushed again after it is popped
+template <class Node>
+class MPSCQueue {
+public:
+    MPSCQueue()
+        : head_(&stub_),
+          tail_(&stub_) {}
+
+    void push(Node* node) { pushNode(node); }
+
+    Node* pop()
+    {
+        // return nullptr if the queue is empty or the only pushed node is not linked yet
+        MPSCQueueNode* tail = tail_;
+        MPSCQueueNode* next = tail->mpsc_next_.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (!next) { return nullptr; }
+            tail_ = tail = next;
+            next = next->mpsc_next_.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail_ = next;
+            return static_cast<Node*>(tail);
+        }
+        if (tail != head_.load(std::memory_order_acquire)) { return nullptr; }
+
+        // the tail is the last node, push the stub behind it so that the tail can be popped
+        pushNode(&stub_);
+        next = tail->mpsc_next_.load(std::memory_order_acquire);
+        if (!next) { return nullptr; }
+        tail_ = next;
+        return static_cast<Node*>(tail);
+    }
+
+private:
+    void pushNode(MPSCQueueNode* node)
+    {
+        node->mpsc_next_.store(nullptr, std::memory_order_relaxed);
+        MPSCQueueNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->mpsc_next_.store(node, std::memory_order_release);
+    }
+
+    MPSCQueueNode stub_;
+    std::atomic<MPSCQueueNode*> head_;
+    MPSCQueueNode* tail_; // only accessed by the consumer
+};
+
+} // namespace minizero::utils
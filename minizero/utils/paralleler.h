@@ -1,7 +1,19 @@
 #pragma once
 
+#include "thread_affinity.h"
+#include <algorithm>
+#include <atomic>
 #include <boost/thread.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace minizero::utils {
@@ -12,10 +24,252 @@ public:
     virtual ~BaseSharedData() = default;
 };
 
+// hands out the indices [0, size) to the threads without a global lock
+// each thread owns a range and takes indices from its front, a thread with an empty range steals the back half of the largest remaining range
+// with thread groups (e.g., the NUMA nodes of the threads), a thread only steals from the threads in its group
+class WorkStealingRanges {
+public:
+    WorkStealingRanges()
+        : num_threads_(0) {}
+
+    void reset(int num_threads, int size)
+    {
+        // not thread-safe, called before the threads start
+        if (num_threads != num_threads_) {
+            num_threads_ = num_threads;
+            ranges_.reset(new Range[num_threads_]);
+        }
+        for (int id = 0; id < num_threads_; ++id) { ranges_[id].range_.store(pack(static_cast<int64_t>(size) * id / num_threads_, static_cast<int64_t>(size) * (id + 1) / num_threads_), std::memory_order_relaxed); }
+    }
+
+    void setThreadGroups(const std::vector<int>& thread_groups) { thread_groups_ = thread_groups; }
+
+    int getNextIndex(int thread_id)
+    {
+        // return -1 when all indices are taken
+        std::atomic<uint64_t>& range = ranges_[thread_id].range_;
+        uint64_t current = range.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t begin = getBegin(current), end = getEnd(current);
+            if (begin < end) {
+                if (range.compare_exchange_weak(current, pack(begin + 1, end), std::memory_order_acq_rel)) { return begin; }
+                continue;
+            }
+            if (!steal(thread_id)) { return -1; }
+            current = range.load(std::memory_order_acquire);
+        }
+    }
+
+private:
+    struct alignas(64) Range {
+        std::atomic<uint64_t> range_;
+    };
+
+    bool steal(int thread_id)
+    {
+        while (true) {
+            int victim = -1;
+            uint64_t victim_range = 0;
+            uint32_t victim_size = 0;
+            for (int id = 0; id < num_threads_; ++id) {
+                if (!thread_groups_.empty() && thread_groups_[id] != thread_groups_[thread_id]) { continue; }
+                uint64_t current = ranges_[id].range_.load(std::memory_order_acquire);
+                uint32_t size = (getEnd(current) > getBegin(current) ? getEnd(current) - getBegin(current) : 0);
+                if (size > victim_size) {
+                    victim = id;
+                    victim_range = current;
+                    victim_size = size;
+                }
+            }
+            if (victim == -1) { return false; }
+
+            // the range of this thread is empty, so no other thread changes it before the stolen half is stored
+            uint32_t begin = getBegin(victim_range), end = getEnd(victim_range), steal_size = (victim_size + 1) / 2;
+            if (ranges_[victim].range_.compare_exchange_strong(victim_range, pack(begin, end - steal_size), std::memory_order_acq_rel)) {
+                ranges_[thread_id].range_.store(pack(end - steal_size, end), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    inline uint64_t pack(uint64_t begin, uint64_t end) const { return (begin << 32) | end; }
+    inline uint32_t getBegin(uint64_t range) const { return range >> 32; }
+    inline uint32_t getEnd(uint64_t range) const { return range & 0xFFFFFFFF; }
+
+    int num_threads_;
+    std::unique_ptr<Range[]> ranges_;
+    std::vector<int> thread_groups_;
+};
+
+// a task-based pool whose threads sleep until tasks arrive, there is no start/finish rendezvous between the threads
+// each thread owns a task queue, it runs its newest task first and steals the oldest task of another thread when its queue is empty
+class ThreadPool {
+public:
+    ThreadPool(int num_threads, const std::vector<int>& thread_cpus = {}, std::function<void(int)> initialize = nullptr)
+        : num_threads_(std::max(1, num_threads)),
+          queues_(new TaskQueue[num_threads_]),
+          num_pending_tasks_(0),
+          next_queue_(0),
+          is_stopped_(false),
+          initialize_(initialize)
+    {
+        // thread i is pinned to thread_cpus[i] if given, initialize(i) runs on thread i before any task, e.g., to seed the random generator
+        // a calling thread outside the pool runs initialize(num_threads) before it runs the chunks of its first parallelFor
+        for (int id = 0; id < num_threads_; ++id) {
+            int cpu = (id < static_cast<int>(thread_cpus.size()) ? thread_cpus[id] : -1);
+            threads_.emplace_back(&ThreadPool::run, this, id, cpu);
+        }
+    }
+
+    ~ThreadPool()
+    {
+        // the submitted tasks are still run before the threads exit
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            is_stopped_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : threads_) { t.join(); }
+    }
+
+    template <class F>
+    std::future<std::invoke_result_t<F>> submit(F&& f)
+    {
+        using Result = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+        std::future<Result> future = task->get_future();
+        push([task]() { (*task)(); });
+        return future;
+    }
+
+    template <class F>
+    void parallelFor(int begin, int end, int chunk_size, F&& f)
+    {
+        // call f(index, thread_id) for each index in [begin, end) and return when all calls are finished
+        // the indices are handed out in chunks of chunk_size (<= 0 for about four chunks per thread), the calling thread also runs chunks
+        // thread_id is the pool thread running the chunk, or getNumThreads() for a calling thread outside the pool
+        if (begin >= end) { return; }
+        if (chunk_size <= 0) { chunk_size = std::max(1, (end - begin) / (4 * (num_threads_ + 1))); }
+
+        if (current_pool_ != this && initialize_ && initialized_caller_ != std::this_thread::get_id()) {
+            initialize_(num_threads_);
+            initialized_caller_ = std::this_thread::get_id();
+        }
+
+        const int num_chunks = (end - begin + chunk_size - 1) / chunk_size;
+        auto state = std::make_shared<ParallelForState>();
+        auto run_chunks = [this, state, begin, end, chunk_size, num_chunks, &f]() {
+            // a late helper finds no chunk left and never touches f, so f only needs to outlive this call
+            const int thread_id = (current_pool_ == this ? current_thread_id_ : num_threads_);
+            for (int chunk = state->next_chunk_++; chunk < num_chunks; chunk = state->next_chunk_++) {
+                const int chunk_end = std::min(end, begin + (chunk + 1) * chunk_size);
+                for (int index = begin + chunk * chunk_size; index < chunk_end; ++index) { f(index, thread_id); }
+                if (state->num_finished_chunks_.fetch_add(1) + 1 < num_chunks) { continue; }
+
+                // the last chunk wakes the calling thread, which waits under the same lock so that it cannot miss the notification
+                std::lock_guard<std::mutex> lock(state->mutex_);
+                state->cv_.notify_one();
+            }
+        };
+
+        for (int i = 0; i < std::min(num_chunks - 1, num_threads_); ++i) { push(run_chunks); }
+        run_chunks();
+        std::unique_lock<std::mutex> lock(state->mutex_);
+        state->cv_.wait(lock, [&state, num_chunks] { return state->num_finished_chunks_ == num_chunks; });
+    }
+
+    inline int getNumThreads() const { return num_threads_; }
+
+private:
+    struct alignas(64) TaskQueue {
+        std::mutex mutex_;
+        std::deque<std::function<void()>> tasks_;
+    };
+
+    struct ParallelForState {
+        std::atomic<int> next_chunk_{0};
+        std::atomic<int> num_finished_chunks_{0};
+        std::mutex mutex_;
+        std::condition_variable cv_;
+    };
+
+    void run(int id, int cpu)
+    {
+        current_pool_ = this;
+        current_thread_id_ = id;
+        if (cpu != -1) { pinCurrentThread(cpu); }
+        if (initialize_) { initialize_(id); }
+
+        std::function<void()> task;
+        while (true) {
+            if (popTask(id, task)) {
+                task();
+                task = nullptr;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return num_pending_tasks_ > 0 || is_stopped_; });
+            if (is_stopped_ && num_pending_tasks_ <= 0) { return; }
+        }
+    }
+
+    void push(std::function<void()> task)
+    {
+        // a pool thread keeps its own tasks, others are spread over the queues
+        int id = (current_pool_ == this ? current_thread_id_ : next_queue_++ % num_threads_);
+        {
+            std::lock_guard<std::mutex> lock(queues_[id].mutex_);
+            queues_[id].tasks_.push_back(std::move(task));
+        }
+
+        // counted under mutex_ so that a thread going to sleep cannot miss it
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++num_pending_tasks_;
+        }
+        cv_.notify_one();
+    }
+
+    bool popTask(int id, std::function<void()>& task)
+    {
+        for (int i = 0; i < num_threads_; ++i) {
+            TaskQueue& queue = queues_[(id + i) % num_threads_];
+            std::lock_guard<std::mutex> lock(queue.mutex_);
+            if (queue.tasks_.empty()) { continue; }
+            if (i == 0) {
+                task = std::move(queue.tasks_.back());
+                queue.tasks_.pop_back();
+            } else {
+                task = std::move(queue.tasks_.front());
+                queue.tasks_.pop_front();
+            }
+            --num_pending_tasks_;
+            return true;
+        }
+        return false;
+    }
+
+    static inline thread_local ThreadPool* current_pool_ = nullptr;
+    static inline thread_local int current_thread_id_ = -1;
+
+    int num_threads_;
+    std::unique_ptr<TaskQueue[]> queues_;
+    std::atomic<int> num_pending_tasks_;
+    std::atomic<unsigned int> next_queue_;
+    bool is_stopped_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::function<void(int)> initialize_;
+    std::thread::id initialized_caller_; // the calling thread outside the pool that has run initialize_(num_threads_)
+    std::vector<std::thread> threads_;
+};
+
 class BaseSlaveThread {
 public:
     BaseSlaveThread(int id, std::shared_ptr<BaseSharedData> shared_data)
         : id_(id),
+          cpu_(-1),
           shared_data_(shared_data),
           start_barrier_(2),
           finish_barrier_(2) {}
@@ -23,6 +277,7 @@ public:
 
     void run()
     {
+        if (cpu_ != -1) { pinCurrentThread(cpu_); }
         initialize();
         while (!isDone()) {
             start_barrier_.wait();
@@ -37,9 +292,12 @@ public:
 
     inline void start() { start_barrier_.wait(); }
     inline void finish() { finish_barrier_.wait(); }
+    inline int getCPU() const { return cpu_; }
+    inline void setCPU(int cpu) { cpu_ = cpu; }
 
 protected:
     int id_;
+    int cpu_; // -1 for not pinned
     std::shared_ptr<BaseSharedData> shared_data_;
     boost::barrier start_barrier_;
     boost::barrier finish_barrier_;
@@ -67,11 +325,13 @@ public:
     virtual void summarize() = 0;
 
 protected:
-    void createSlaveThreads(int num_threads)
+    void createSlaveThreads(int num_threads, const std::vector<int>& thread_cpus = {})
     {
+        // thread i is pinned to thread_cpus[i] if given, e.g., by getThreadCPUs()
         createSharedData();
         for (int id = 0; id < num_threads; ++id) {
             slave_threads_.emplace_back(newSlaveThread(id));
+            if (id < static_cast<int>(thread_cpus.size())) { slave_threads_.back()->setCPU(thread_cpus[id]); }
             thread_groups_.create_thread(boost::bind(&BaseSlaveThread::run, slave_threads_.back()));
         }
     }
@@ -0,0 +1,174 @@
+#include "profiler.h"
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace minizero::utils {
+
+std::atomic<bool> Profiler::is_enabled_{false};
+
+namespace {
+
+const int kPhaseSize = static_cast<int>(ProfilePhase::kPhaseSize);
+
+class ProfileCounters {
+public:
+    ProfileCounters() { clear(); }
+
+    void clear()
+    {
+        for (int i = 0; i < kPhaseSize; ++i) { phase_counts_[i] = phase_times_[i] = 0; }
+        for (int i = 0; i < Profiler::kHistogramSize; ++i) { batch_size_histogram_[i] = move_latency_histogram_[i] = 0; }
+    }
+
+    int64_t phase_counts_[kPhaseSize];
+    int64_t phase_times_[kPhaseSize]; // in nanoseconds
+    int64_t batch_size_histogram_[Profiler::kHistogramSize];
+    int64_t move_latency_histogram_[Profiler::kHistogramSize]; // in microseconds
+};
+
+// the counters written by one thread, they are atomic only so that the reporting thread can read them
+class alignas(64) ThreadProfile {
+public:
+    ThreadProfile()
+    {
+        for (int i = 0; i < kPhaseSize; ++i) { phase_counts_[i] = phase_times_[i] = 0; }
+        for (int i = 0; i < Profiler::kHistogramSize; ++i) { batch_size_histogram_[i] = move_latency_histogram_[i] = 0; }
+    }
+
+    void addTo(ProfileCounters& counters) const
+    {
+        for (int i = 0; i < kPhaseSize; ++i) {
+            counters.phase_counts_[i] += phase_counts_[i].load(std::memory_order_relaxed);
+            counters.phase_times_[i] += phase_times_[i].load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < Profiler::kHistogramSize; ++i) {
+            counters.batch_size_histogram_[i] += batch_size_histogram_[i].load(std::memory_order_relaxed);
+            counters.move_latency_histogram_[i] += move_latency_histogram_[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<int64_t> phase_counts_[kPhaseSize];
+    std::atomic<int64_t> phase_times_[kPhaseSize];
+    std::atomic<int64_t> batch_size_histogram_[Profiler::kHistogramSize];
+    std::atomic<int64_t> move_latency_histogram_[Profiler::kHistogramSize];
+};
+
+// the profiles are never freed, since the threads may still record while the program exits
+std::mutex profiles_mutex;
+std::vector<ThreadProfile*>& getProfiles()
+{
+    static std::vector<ThreadProfile*>* profiles = new std::vector<ThreadProfile*>();
+    return *profiles;
+}
+
+ThreadProfile& getThreadProfile()
+{
+    thread_local ThreadProfile* profile = [] {
+        std::lock_guard<std::mutex> lock(profiles_mutex);
+        getProfiles().push_back(new ThreadProfile());
+        return getProfiles().back();
+    }();
+    return *profile;
+}
+
+inline void increase(std::atomic<int64_t>& counter, int64_t value)
+{
+    // only the owner thread writes the counter, which avoids a locked read-modify-write
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline int getHistogramBucket(int64_t value)
+{
+    int bucket = 0;
+    while (value > 0 && bucket < Profiler::kHistogramSize - 1) {
+        value >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void writeHistogram(std::ostringstream& oss, const int64_t* histogram)
+{
+    // trailing empty buckets are omitted
+    int size = Profiler::kHistogramSize;
+    while (size > 0 && histogram[size - 1] == 0) { --size; }
+    oss << "[";
+    for (int i = 0; i < size; ++i) { oss << (i > 0 ? ", " : "") << histogram[i]; }
+    oss << "]";
+}
+
+} // namespace
+
+void Profiler::addPhaseTime(ProfilePhase phase, int64_t time_ns)
+{
+    ThreadProfile& profile = getThreadProfile();
+    increase(profile.phase_counts_[static_cast<int>(phase)], 1);
+    increase(profile.phase_times_[static_cast<int>(phase)], time_ns);
+}
+
+void Profiler::addBatchSize(int batch_size)
+{
+    if (!isEnabled()) { return; }
+    increase(getThreadProfile().batch_size_histogram_[getHistogramBucket(batch_size)], 1);
+}
+
+void Profiler::addMoveLatency(int64_t latency_us)
+{
+    if (!isEnabled()) { return; }
+    increase(getThreadProfile().move_latency_histogram_[getHistogramBucket(latency_us)], 1);
+}
+
+std::string Profiler::report()
+{
+    // the counters only grow, so the report is the difference from the totals of the last report
+    static ProfileCounters last_totals;
+    static std::mutex report_mutex;
+    std::lock_guard<std::mutex> report_lock(report_mutex);
+
+    ProfileCounters totals;
+    {
+        std::lock_guard<std::mutex> lock(profiles_mutex);
+        for (const ThreadProfile* profile : getProfiles()) { profile->addTo(totals); }
+    }
+    ProfileCounters counters = totals;
+    for (int i = 0; i < kPhaseSize; ++i) {
+        counters.phase_counts_[i] -= last_totals.phase_counts_[i];
+        counters.phase_times_[i] -= last_totals.phase_times_[i];
+    }
+    for (int i = 0; i < kHistogramSize; ++i) {
+        counters.batch_size_histogram_[i] -= last_totals.batch_size_histogram_[i];
+        counters.move_latency_histogram_[i] -= last_totals.move_latency_histogram_[i];
+    }
+    last_totals = totals;
+
+    std::ostringstream oss;
+    oss << "{\"time\": " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count() << ", \"phases\": {";
+    for (int i = 0; i < kPhaseSize; ++i) {
+        oss << (i > 0 ? ", " : "") << "\"" << getPhaseName(static_cast<ProfilePhase>(i)) << "\": {\"count\": " << counters.phase_counts_[i] << ", \"time_us\": " << counters.phase_times_[i] / 1000 << "}";
+    }
+    oss << "}, \"batch_size_histogram\": ";
+    writeHistogram(oss, counters.batch_size_histogram_);
+    oss << ", \"move_latency_us_histogram\": ";
+    writeHistogram(oss, counters.move_latency_histogram_);
+    oss << "}";
+    return oss.str();
+}
+
+std::string Profiler::getPhaseName(ProfilePhase phase)
+{
+    switch (phase) {
+        case ProfilePhase::kSelection: return "selection";
+        case ProfilePhase::kTransition: return "transition";
+        case ProfilePhase::kFeature: return "feature";
+        case ProfilePhase::kTensor: return "tensor";
+        case ProfilePhase::kForward: return "forward";
+        case ProfilePhase::kDecode: return "decode";
+        case ProfilePhase::kBackup: return "backup";
+        case ProfilePhase::kGameOutput: return "game_output";
+        default: return "unknown";
+    }
+}
+
+} // namespace minizero::utils
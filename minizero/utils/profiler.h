@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace minizero::utils {
+
+enum class ProfilePhase {
+    kSelection,  // selecting a leaf in the tree
+    kTransition, // moving an environment to the leaf
+    kFeature,    // writing the network input of the leaf
+    kTensor,     // building the input tensor of a batch on the device
+    kForward,    // the network forward
+    kDecode,     // copying the outputs of a batch to the host and decoding them
+    kBackup,     // expanding the leaf and backing up its value
+    kGameOutput, // building the record of a game
+    kPhaseSize
+};
+
+// the counters and timers of the self-play hot paths, e.g., for tuning zero_num_threads and zero_num_parallel_games
+// each thread only adds to its own counters, so recording is a few plain stores, and nothing is recorded before enable()
+class Profiler {
+public:
+    static const int kHistogramSize = 32; // bucket 0 counts the values <= 0, bucket i counts the values in [2^(i-1), 2^i)
+
+    static inline void enable() { is_enabled_.store(true, std::memory_order_relaxed); }
+    static inline bool isEnabled() { return is_enabled_.load(std::memory_order_relaxed); }
+
+    static void addPhaseTime(ProfilePhase phase, int64_t time_ns);
+    static void addBatchSize(int batch_size);
+    static void addMoveLatency(int64_t latency_us);
+
+    // the counters since the last report as one JSON line, any thread can report while the others keep recording
+    static std::string report();
+
+    static std::string getPhaseName(ProfilePhase phase);
+
+private:
+    static std::atomic<bool> is_enabled_;
+};
+
+// records the time of a phase when it goes out of scope, next() records the current phase and starts timing another one
+class ProfileTimer {
+public:
+    ProfileTimer(ProfilePhase phase)
+        : phase_(phase), is_enabled_(Profiler::isEnabled())
+    {
+        if (is_enabled_) { start_time_ = std::chrono::steady_clock::now(); }
+    }
+
+    ~ProfileTimer() { stop(); }
+
+    inline void next(ProfilePhase phase)
+    {
+        if (!is_enabled_) { return; }
+        auto now = std::chrono::steady_clock::now();
+        Profiler::addPhaseTime(phase_, std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_time_).count());
+        phase_ = phase;
+        start_time_ = now;
+    }
+
+    inline void stop()
+    {
+        if (!is_enabled_) { return; }
+        Profiler::addPhaseTime(phase_, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time_).count());
+        is_enabled_ = false;
+    }
+
+private:
+    ProfilePhase phase_;
+    bool is_enabled_;
+    std::chrono::steady_clock::time_point start_time_;
+};
+
+} // namespace minizero::utils
@@ -92,4 +92,17 @@ inline int getPositionByRotating(Rotation rotation, int original_pos, int board_
     return new_pos;
 }
 
+inline const std::vector<int>& getRotationTable(Rotation rotation, int board_size)
+{
+    // getPositionByRotating of all positions (including pass), computed once per thread for each board size and rotation
+    thread_local std::vector<std::vector<int>> tables[static_cast<int>(Rotation::kRotateSize)];
+    std::vector<std::vector<int>>& board_tables = tables[static_cast<int>(rotation)];
+    if (board_size >= static_cast<int>(board_tables.size())) { board_tables.resize(board_size + 1); }
+    std::vector<int>& table = board_tables[board_size];
+    if (table.empty()) {
+        for (int pos = 0; pos <= board_size * board_size; ++pos) { table.push_back(getPositionByRotating(rotation, pos, board_size)); }
+    }
+    return table;
+}
+
 } // namespace minizero::utils
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace minizero::utils {
+
+// a bounded lock-free ring buffer, push must be called by a single producer thread and pop by a single consumer thread
+template <class T>
+class SPSCQueue {
+public:
+    SPSCQueue(size_t capacity)
+        : head_(0),
+          tail_(0)
+    {
+        size_t size = 1;
+        while (size < capacity) { size <<= 1; }
+        buffer_.resize(size);
+        mask_ = size - 1;
+    }
+
+    template <class U>
+    bool tryPush(U&& value)
+    {
+        // return false if the queue is full
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == buffer_.size()) { return false; }
+        buffer_[tail & mask_] = std::forward<U>(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& value)
+    {
+        // return false if the queue is empty
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) { return false; }
+        value = std::move(buffer_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    inline bool empty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+    inline size_t capacity() const { return buffer_.size(); }
+
+private:
+    std::vector<T> buffer_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_; // written by the consumer
+    alignas(64) std::atomic<size_t> tail_; // written by the producer
+};
+
+} // namespace minizero::utils
@@ -0,0 +1,140 @@
+#include "thread_affinity.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace minizero::utils {
+
+namespace {
+
+std::vector<int> parseCPUList(const std::string& cpu_list)
+{
+    // the format of the kernel, e.g., "0-7,16-23"
+    std::vector<int> cpus;
+    std::string token;
+    std::istringstream iss(cpu_list);
+    while (std::getline(iss, token, ',')) {
+        if (token.empty()) { continue; }
+        size_t dash = token.find('-');
+        int first = std::stoi(token.substr(0, dash));
+        int last = (dash == std::string::npos ? first : std::stoi(token.substr(dash + 1)));
+        for (int cpu = first; cpu <= last; ++cpu) { cpus.push_back(cpu); }
+    }
+    return cpus;
+}
+
+const std::vector<std::vector<int>>& getNUMANodeCPUs()
+{
+    // the CPUs of each NUMA node, all CPUs are on node 0 if the topology is unavailable
+    static const std::vector<std::vector<int>> node_cpus = [] {
+        const int max_num_nodes = 64;
+        std::vector<std::vector<int>> node_cpus;
+        for (int node = 0; node < max_num_nodes; ++node) {
+            std::ifstream fin("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string cpu_list;
+            if (!fin || !std::getline(fin, cpu_list)) { continue; }
+            node_cpus.resize(node + 1);
+            node_cpus[node] = parseCPUList(cpu_list);
+        }
+        if (node_cpus.empty()) {
+            node_cpus.resize(1);
+            for (int cpu = 0; cpu < static_cast<int>(std::thread::hardware_concurrency()); ++cpu) { node_cpus[0].push_back(cpu); }
+        }
+        return node_cpus;
+    }();
+    return node_cpus;
+}
+
+std::vector<int> getAllowedCPUs()
+{
+    // the CPUs the calling thread may run on, e.g., restricted by taskset, cgroups, or a job scheduler; empty if unknown
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &cpu_set) != 0) { return {}; }
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &cpu_set)) { cpus.push_back(cpu); }
+    }
+    return cpus;
+#else
+    return {};
+#endif
+}
+
+} // namespace
+
+int getNUMANode(int cpu)
+{
+    const std::vector<std::vector<int>>& node_cpus = getNUMANodeCPUs();
+    for (size_t node = 0; node < node_cpus.size(); ++node) {
+        for (int node_cpu : node_cpus[node]) {
+            if (node_cpu == cpu) { return node; }
+        }
+    }
+    return 0;
+}
+
+std::vector<int> getThreadCPUs(const std::string& affinity, int num_threads)
+{
+    if (affinity.empty() || num_threads <= 0) { return {}; }
+
+    // "auto" fills the CPUs of a node before the next one, so that the threads share as few nodes as possible
+    std::vector<int> cpus;
+    if (affinity == "auto") {
+        for (const auto& node_cpus : getNUMANodeCPUs()) { cpus.insert(cpus.end(), node_cpus.begin(), node_cpus.end()); }
+    } else {
+        cpus = parseCPUList(affinity);
+    }
+
+    // only the CPUs allowed for the process are used, pinning a thread to the others fails
+    std::vector<int> allowed_cpus = getAllowedCPUs();
+    if (!allowed_cpus.empty()) {
+        std::vector<int> skipped_cpus;
+        auto is_skipped = [&allowed_cpus, &skipped_cpus](int cpu) {
+            if (std::find(allowed_cpus.begin(), allowed_cpus.end(), cpu) != allowed_cpus.end()) { return false; }
+            skipped_cpus.push_back(cpu);
+            return true;
+        };
+        cpus.erase(std::remove_if(cpus.begin(), cpus.end(), is_skipped), cpus.end());
+        if (!skipped_cpus.empty() && affinity != "auto") {
+            std::cerr << "Skip the CPUs not allowed for the process:";
+            for (int cpu : skipped_cpus) { std::cerr << " " << cpu; }
+            std::cerr << std::endl;
+        }
+    }
+    if (cpus.empty()) {
+        std::cerr << "No allowed CPU in the thread affinity \"" << affinity << "\", the threads are not pinned." << std::endl;
+        return {};
+    }
+
+    std::vector<int> thread_cpus(num_threads);
+    for (int id = 0; id < num_threads; ++id) { thread_cpus[id] = cpus[id % cpus.size()]; }
+    return thread_cpus;
+}
+
+bool pinCurrentThread(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+    if (error != 0) { std::cerr << "Failed to pin a thread to CPU " << cpu << ": " << std::strerror(error) << std::endl; }
+    return error == 0;
+#else
+    std::cerr << "Pinning threads is not supported on this platform." << std::endl;
+    return false;
+#endif
+}
+
+} // namespace minizero::utils
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace minizero::utils {
+
+// the NUMA node of a CPU read from /sys/devices/system/node, 0 if the topology is unavailable
+int getNUMANode(int cpu);
+
+// the CPUs to pin num_threads threads to, thread i is pinned to the i-th CPU
+// affinity is "" for no pinning (an empty list), "auto" for the online CPUs ordered by NUMA nodes, or a CPU list, e.g., "0-7,16-23"
+// the CPUs not allowed for the process (sched_getaffinity) are skipped, and an empty list is returned if none is allowed
+std::vector<int> getThreadCPUs(const std::string& affinity, int num_threads);
+
+// pin the calling thread to the CPU, return false and log the reason if it fails
+bool pinCurrentThread(int cpu);
+
+} // namespace minizero::utils